@@ -0,0 +1,168 @@
+#include "Editor.h"
+#include "NPCFactory.h"
+#include "NPCTypes.h"
+#include "VariantWorld.h"
+#include "CompactWorld.h"
+#include "KillMatrix.h"
+#include "EventLog.h"
+#include "Trace.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+// Usage: Lab7_bench [npcs] [distance] [seed]
+// Prints timings for each storage/battle strategy on the same world.
+
+static std::vector<NPCPtr> makeWorld(int count, unsigned seed) {
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<> pos(0.0, 500.0);
+    std::uniform_int_distribution<> type(0, 2);
+
+    std::vector<NPCPtr> npcs;
+    npcs.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        NPCType t = static_cast<NPCType>(type(gen));
+        double x = pos(gen);
+        double y = pos(gen);
+        npcs.push_back(NPCFactory::create(t, "NPC" + std::to_string(i), x, y));
+    }
+    return npcs;
+}
+
+template <typename Fn>
+static double timeMs(Fn &&fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static void report(const std::string &label, double ms, size_t count, const char *what = "survivors") {
+    std::cout << std::left << std::setw(28) << label
+              << std::right << std::setw(10) << std::fixed << std::setprecision(2) << ms << " ms"
+              << "   " << what << ": " << count << std::endl;
+}
+
+int main(int argc, char **argv) {
+    int count = argc > 1 ? std::atoi(argv[1]) : 5000;
+    double distance = argc > 2 ? std::atof(argv[2]) : 10.0;
+    unsigned seed = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : 1;
+
+    auto world = makeWorld(count, seed);
+    std::cout << "=== Lab7 benchmark: " << count << " NPCs, distance " << distance
+              << ", seed " << seed << " ===" << std::endl;
+
+    {
+        // Pairs the species partition actually scans in the first round.
+        std::array<double, NPC_TYPE_COUNT> per_type{};
+        for (auto &n : world) per_type[static_cast<size_t>(n->kind())] += 1;
+        double all = world.size() * (world.size() - 1.0) / 2;
+        double scanned = 0;
+        for (auto [a, b] : KillMatrix::standard().interactingPairs()) {
+            double na = per_type[static_cast<size_t>(a)], nb = per_type[static_cast<size_t>(b)];
+            scanned += a == b ? na * (na - 1) / 2 : na * nb;
+        }
+        std::cout << "Species partition scans " << std::fixed << std::setprecision(1)
+                  << (all > 0 ? 100.0 * scanned / all : 0.0) << "% of all pairs" << std::endl;
+    }
+
+    {
+        Editor ed;
+        for (auto &n : world) ed.addNPC(n);
+        double ms = timeMs([&] { ed.runBattle(distance); });
+        report("Editor (virtual dispatch)", ms, ed.npcs().size());
+    }
+
+    {
+        // Same battle with markers recording, and the cost of an idle one.
+        Editor ed;
+        for (auto &n : world) ed.addNPC(n);
+        traceEnable(true);
+        double ms = timeMs([&] { ed.runBattle(distance); });
+        traceEnable(false);
+        traceClear();
+        report("Editor (tracing on)", ms, ed.npcs().size());
+
+        const int scopes = 10'000'000;
+        ms = timeMs([&] {
+            for (int i = 0; i < scopes; ++i) {
+                TRACE_SCOPE("bench.idle");
+            }
+        });
+        std::cout << "Idle TRACE_SCOPE: " << std::setprecision(2) << ms * 1e6 / scopes << " ns each" << std::endl;
+    }
+
+    {
+        VariantWorld vw(world);
+        double ms = timeMs([&] { vw.runBattle(distance); });
+        report("VariantWorld (std::visit)", ms, vw.size());
+    }
+
+    {
+        CompactWorld16 narrow(world);
+        double ms = timeMs([&] { narrow.runBattle(distance); });
+        report("CompactWorld<uint16_t>", ms, narrow.size());
+
+        CompactWorld32 wide(world);
+        ms = timeMs([&] { wide.runBattle(distance); });
+        report("CompactWorld<uint32_t>", ms, wide.size());
+
+        // NPC object + make_shared control block + the Editor's pointer;
+        // names fit the string's inline buffer here.
+        size_t object_bytes = sizeof(Bear) + 16 + sizeof(NPCPtr);
+        std::cout << "Bytes per NPC: shared_ptr<NPC> ~" << object_bytes
+                  << ", CompactWorld<uint16_t> " << CompactWorld16::bytesPerNPC()
+                  << ", CompactWorld<uint32_t> " << CompactWorld32::bytesPerNPC()
+                  << " (+ shared name table); uint16 step " << std::setprecision(4) << narrow.step()
+                  << ", tolerance " << narrow.tolerance() << std::endl;
+    }
+
+    {
+        const std::string file = "bench_save.txt";
+        Editor ed;
+        for (auto &n : makeWorld(std::max(count, 200'000), seed)) ed.addNPC(n);
+        for (unsigned threads : {1u, 0u}) {
+            double ms = timeMs([&] { ed.saveToFile(file, threads); });
+            report(threads == 1 ? "saveToFile (1 thread)" : "saveToFile (all cores)", ms, ed.size(), "npcs");
+        }
+
+        for (unsigned threads : {1u, 0u}) {
+            Editor loaded;
+            double ms = timeMs([&] { loaded.loadFromFile(file, threads); });
+            report(threads == 1 ? "loadFromFile (1 thread)" : "loadFromFile (all cores)", ms, loaded.size(), "npcs");
+        }
+        std::filesystem::remove(file);
+    }
+
+    {
+        const int events = 2'000'000;
+        const std::string base = "bench_event_log";
+        NameTable names;
+        std::vector<NPCId> ids;
+        for (int i = 0; i < 1000; ++i) ids.push_back(names.intern("NPC" + std::to_string(i)));
+
+        double ms = timeMs([&] {
+            EventLogWriter log(base);
+            for (int i = 0; i < events; ++i) {
+                NPCId k = ids[i % 1000], v = ids[(i * 7 + 1) % 1000];
+                log.append({static_cast<std::uint64_t>(i / 16), k, v, NPCType::Bear, NPCType::Desman,
+                            (i % 500) * 1.0, (i % 300) * 1.0},
+                           names.name(k), names.name(v));
+            }
+        });
+        auto bytes = std::filesystem::file_size(eventLogSegmentPath(base, 0));
+        std::cout << std::left << std::setw(28) << "EventLogWriter"
+                  << std::right << std::setw(10) << std::fixed << std::setprecision(2) << ms << " ms"
+                  << "   " << std::setprecision(1) << events / ms / 1000.0 << " M events/s, "
+                  << std::setprecision(2) << static_cast<double>(bytes) / events << " bytes/event" << std::endl;
+        std::filesystem::remove(eventLogSegmentPath(base, 0));
+    }
+
+    return 0;
+}
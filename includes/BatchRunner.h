@@ -0,0 +1,49 @@
+#pragma once
+#include "Game.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BatchOptions {
+    size_t runs = 1000;
+    // Worker threads, each replaying games on its own reused Game;
+    // 0 means one per hardware thread.
+    unsigned threads = 0;
+    // Run i uses seed base_seed + i, independent of the thread count.
+    std::uint64_t base_seed = 1;
+    std::chrono::milliseconds duration = std::chrono::seconds(30);
+    // See GameConfig::discrete_events.
+    bool discrete_events = false;
+};
+
+// Distribution of a survival rate (survivors / initial) over the runs in
+// which the population was non-empty at the start.
+struct SurvivalStats {
+    size_t samples = 0;
+    double mean = 0;
+    double stddev = 0;
+    double min = 0;
+    double p5 = 0;
+    double p50 = 0;
+    double p95 = 0;
+    double max = 0;
+};
+
+struct BatchSummary {
+    size_t runs = 0;
+    size_t ended_early = 0;
+    double mean_sim_seconds = 0;
+    std::array<SurvivalStats, NPC_TYPE_COUNT> species{};
+    SurvivalStats overall;
+};
+
+// Plays opts.runs headless games (see Game::runHeadless) on a pool of
+// threads. Results are indexed by run, so they do not depend on scheduling.
+std::vector<GameResult> runBatch(const BatchOptions &opts);
+
+BatchSummary summarizeBatch(const std::vector<GameResult> &results);
+
+// Writes the summary as a small text report.
+void writeBatchSummary(const BatchSummary &summary, const std::string &path);
@@ -0,0 +1,49 @@
+#pragma once
+#include "NameTable.h"
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// Which NPCs changed in each published world version, recorded by Game on
+// its move and kill paths. Readers (the query server) merge a range of
+// versions into one delta without touching the world itself.
+class ChangeLog {
+public:
+    struct Changes {
+        std::vector<NPCId> moved, removed, spawned;
+    };
+
+private:
+    struct Entry {
+        std::uint64_t version;
+        bool reset;
+        Changes changes;
+    };
+
+    // Built by the writer between commits, under the owner's world lock.
+    Entry pending_{0, false, {}};
+
+    mutable std::mutex mutex_;
+    std::deque<Entry> entries_;
+    size_t capacity_;
+
+public:
+    // Keeps the changes of the last `capacity` versions.
+    explicit ChangeLog(size_t capacity = 1024) : capacity_(capacity ? capacity : 1) {}
+
+    void moved(NPCId id) { pending_.changes.moved.push_back(id); }
+    void removed(NPCId id) { pending_.changes.removed.push_back(id); }
+    void spawned(NPCId id) { pending_.changes.spawned.push_back(id); }
+    // The whole world was replaced (generated, loaded); ranges across this
+    // version cannot be expressed as a delta.
+    void reset() { pending_.reset = true; }
+
+    // Closes the pending changes as those of `version`.
+    void commit(std::uint64_t version);
+
+    // Merges the changes of versions (from, to] into `out`, each list
+    // sorted and without duplicates. False if part of the range is no
+    // longer kept or crosses a reset.
+    bool collect(std::uint64_t from, std::uint64_t to, Changes &out) const;
+};
@@ -0,0 +1,67 @@
+#pragma once
+#include "NPC.h"
+#include "NameTable.h"
+#include "Observer.h"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Memory-lean world for very large populations. Each NPC is a column entry:
+// two fixed-point coordinates of type Coord scaled to [0, extent], a one
+// byte type tag and an interned name id, i.e. 9 bytes with uint16_t and 13
+// with uint32_t (names are shared through the NameTable). uint32_t worlds
+// use 31 bits per axis so squared distances fit in 64 bits.
+//
+// Battles run entirely on the integers. Quantization moves every point by
+// at most step()/2 per axis, so a pair's in-range decision can only differ
+// from the double path (Editor::runBattle) when its true distance is within
+// tolerance() = sqrt(2) * step() of the battle distance.
+template <typename Coord>
+class CompactWorld {
+    double extent_;
+    double scale_;
+    std::vector<Coord> xs_, ys_;
+    std::vector<std::uint8_t> kinds_;
+    std::vector<NPCId> names_;
+    NameTable table_;
+    std::vector<ObsPtr> observers_;
+
+    Coord quantize(double v) const;
+    void sortByX();
+public:
+    explicit CompactWorld(double extent = 500.0);
+    explicit CompactWorld(const std::vector<NPCPtr> &npcs, double extent = 500.0);
+
+    void addObserver(ObsPtr obs);
+
+    // Returns false if the position is outside [0, extent].
+    bool add(NPCType type, std::string_view name, double x, double y);
+    bool add(const NPC &npc) { return add(npc.kind(), npc.name(), npc.x(), npc.y()); }
+
+    size_t size() const { return xs_.size(); }
+    NPCType kind(size_t i) const { return static_cast<NPCType>(kinds_[i]); }
+    std::string_view name(size_t i) const { return table_.name(names_[i]); }
+    double x(size_t i) const { return xs_[i] / scale_; }
+    double y(size_t i) const { return ys_[i] / scale_; }
+
+    double step() const { return 1.0 / scale_; }
+    double tolerance() const;
+    static constexpr size_t bytesPerNPC() {
+        return 2 * sizeof(Coord) + sizeof(std::uint8_t) + sizeof(NPCId);
+    }
+    // Bytes reserved by the per-NPC columns (excluding the name table).
+    size_t memoryBytes() const;
+
+    std::vector<NPCPtr> toNPCs() const;
+
+    // Same semantics and pruning as Editor::runBattle; kills within a round
+    // are reported in x-sorted pair order rather than insertion order.
+    // Reorders the NPCs by x unless the world is already terminal.
+    void runBattle(double distance);
+};
+
+using CompactWorld16 = CompactWorld<std::uint16_t>;
+using CompactWorld32 = CompactWorld<std::uint32_t>;
+
+extern template class CompactWorld<std::uint16_t>;
+extern template class CompactWorld<std::uint32_t>;
@@ -0,0 +1,72 @@
+#pragma once
+#include "Editor.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <random>
+#include <vector>
+
+struct DiscreteEventOptions {
+    double move_distance = 5.0;
+    double kill_distance = 20.0;
+    double width = 100.0;
+    double height = 100.0;
+    // Delay before each NPC's next action, uniform in [min_delay, max_delay].
+    // The defaults give every NPC the average move rate it has in Game's
+    // tick mode with 50 NPCs (one random NPC every 50-200 ms).
+    std::chrono::milliseconds min_delay{2500};
+    std::chrono::milliseconds max_delay{10000};
+};
+
+struct DiscreteEventStats {
+    std::uint64_t actions = 0;  // events processed
+    std::uint64_t checks = 0;   // neighbour pairs tested for a fight
+    std::uint64_t kills = 0;
+};
+
+// Event-driven alternative to Game's tick loop. Every NPC owns one pending
+// action in a time-ordered queue. An action moves the NPC by up to
+// move_distance per axis and then fights only the NPCs within
+// kill_distance of its new position (found through the Editor's grid),
+// with the same dice as Game::battleStep. Cost therefore follows the number
+// of events and their neighbourhoods, not population x ticks.
+class DiscreteEventSim {
+    struct Event {
+        std::chrono::milliseconds time;
+        std::uint64_t seq;  // FIFO among equal times, for determinism
+        NPCHandle npc;
+        bool operator>(const Event &o) const { return time != o.time ? time > o.time : seq > o.seq; }
+    };
+
+    Editor &editor_;
+    DiscreteEventOptions opts_;
+    std::mt19937 gen_;
+    std::priority_queue<Event, std::vector<Event>, std::greater<>> queue_;
+    std::uint64_t seq_ = 0;
+    std::chrono::milliseconds now_{0};
+    DiscreteEventStats stats_;
+    std::vector<NPCHandle> neighbours_;
+
+    void schedule(NPCHandle h, std::chrono::milliseconds after);
+public:
+    // Schedules a first action for every NPC already in `editor`.
+    DiscreteEventSim(Editor &editor, std::uint64_t seed, DiscreteEventOptions opts = {});
+
+    // Schedules an NPC added to the editor after construction.
+    void add(NPCHandle h);
+
+    // Processes the earliest pending action, appending its kills (names not
+    // yet resolved) to `kills`. NPCs that moved are passed to `moved` if
+    // given. Returns false when nothing is scheduled.
+    bool step(std::vector<KillEvent> &kills, const std::function<void(NPCHandle)> &moved = {});
+    // Runs every action due before `until`, delivering each action's kills
+    // to the editor's observers.
+    void runUntil(std::chrono::milliseconds until);
+
+    // Time of the next action; max() if none.
+    std::chrono::milliseconds nextTime() const;
+    std::chrono::milliseconds now() const { return now_; }
+    size_t pending() const { return queue_.size(); }
+    const DiscreteEventStats& stats() const { return stats_; }
+};
@@ -1,24 +1,106 @@
 #pragma once
 #include "NPC.h"
+#include "NameTable.h"
 #include "Observer.h"
+#include "PopulationStats.h"
+#include "SlotMap.h"
+#include "SpatialGrid.h"
+#include <cstdint>
+#include <span>
 #include <vector>
 #include <string>
 
+using NPCHandle = SlotHandle;
+
 class Editor {
-    std::vector<NPCPtr> npcs_;
+    SlotMap<NPCPtr> npcs_;
+    std::vector<NPCId> ids_;
+    std::vector<NPCHandle> handle_of_;
+    NameTable names_;
     std::vector<ObsPtr> observers_;
+    PopulationStats stats_;
+
+    static constexpr double WORLD_SIZE = 500.0;
+    static constexpr double GRID_CELL = 20.0;
+    SpatialGrid grid_{WORLD_SIZE, WORLD_SIZE, GRID_CELL};
+
+    static bool inBounds(double x, double y) {
+        return x >= 0 && x <= WORLD_SIZE && y >= 0 && y <= WORLD_SIZE;
+    }
+    // Adds an NPC whose bounds and name uniqueness were already checked.
+    void insert(NPCPtr npc, NPCId id);
 public:
     void addObserver(ObsPtr obs);
     void removeObserver(ObsPtr obs);
 
     bool addNPC(NPCPtr npc);
 
-    void saveToFile(const std::string &filename) const;
-    void loadFromFile(const std::string &filename);
+    // Same text format as NPC::serialize, formatted on `threads` workers
+    // (0 picks one per core for large worlds) and renamed into place.
+    void saveToFile(const std::string &filename, unsigned threads = 0) const;
+    // Memory-maps the file and parses chunks of whole records on `threads`
+    // workers (0 picks one per core for large files), then validates bounds
+    // and name uniqueness in parallel before inserting anything. Errors are
+    // those the serial reader would hit first in file order.
+    void loadFromFile(const std::string &filename, unsigned threads = 0);
 
     void printAll(std::ostream &os) const;
 
+    // Removes every NPC but keeps the storage, index and interned names, so
+    // refilling the editor reuses the same memory.
+    void clear();
+
     void runBattle(double distance);
 
-    const std::vector<NPCPtr>& npcs() const { return npcs_; }
-};
\ No newline at end of file
+    // Fills killer_name/victim_name from this world's name table.
+    void resolveNames(std::span<KillEvent> events) const;
+    // Delivers one batch to every observer through onKills.
+    void dispatch(std::span<const KillEvent> events) const;
+
+    // Dense NPC array in insertion order. After kill() it holds null
+    // tombstones until compact(); every other operation leaves it compact.
+    const std::vector<NPCPtr>& npcs() const { return npcs_.values(); }
+    // handles()[i] is the handle of npcs()[i].
+    const std::vector<NPCHandle>& handles() const { return npcs_.handles(); }
+    const NameTable& names() const { return names_; }
+    size_t size() const { return npcs_.size(); }
+
+    // Live per-type (and optionally per-region) counts, kept up to date by
+    // addNPC/kill/moveNPC. Safe to read without holding the owner's lock.
+    const PopulationStats& stats() const { return stats_; }
+    // Starts per-region counting over a cols x rows grid and seeds it from
+    // the current population.
+    void enableRegionStats(int cols, int rows, double width, double height);
+
+    NPCId idOf(NPCHandle h) const { return ids_[h.index]; }
+    NPCHandle handleOf(NPCId id) const;
+    NPCPtr find(NPCHandle h) const;
+    NPCPtr find(NPCId id) const { return find(handleOf(id)); }
+
+    // Spatial queries over the live NPCs, answered from a grid index that
+    // addNPC/moveNPC/kill keep current. fn(NPCHandle, const NPC&) is called
+    // once per match, in no particular order.
+    template <class Fn>
+    void queryRadius(double x, double y, double r, Fn &&fn) const {
+        grid_.forEachInRadius(x, y, r, [&](NPCHandle h, double, double) { fn(h, **npcs_.get(h)); });
+    }
+    template <class Fn>
+    void queryBox(double x0, double y0, double x1, double y1, Fn &&fn) const {
+        grid_.forEachInBox(x0, y0, x1, y1, [&](NPCHandle h, double, double) { fn(h, **npcs_.get(h)); });
+    }
+    // Fills `out` with the handles of the nearest NPCs accepted by
+    // pred(const NPC&), closest first; returns how many were written.
+    template <class Pred>
+    size_t nearestK(double x, double y, std::span<NPCHandle> out, Pred &&pred) const {
+        return grid_.nearestK(x, y, out, [&](NPCHandle h) { return pred(static_cast<const NPC&>(**npcs_.get(h))); });
+    }
+    size_t nearestK(double x, double y, std::span<NPCHandle> out) const {
+        return grid_.nearestK(x, y, out, [](NPCHandle) { return true; });
+    }
+
+    bool moveNPC(NPCHandle h, double x, double y);
+    bool kill(NPCHandle h);
+    size_t tombstones() const { return npcs_.tombstones(); }
+    void compact() { npcs_.compact(); }
+    bool compactIfSparse() { return npcs_.compactIfSparse(); }
+};
@@ -0,0 +1,97 @@
+#pragma once
+#include "NPC.h"
+#include "NameTable.h"
+#include "Observer.h"
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct KillRecord {
+    std::uint64_t tick;
+    NPCId killer;
+    NPCId victim;
+    NPCType killer_kind;
+    NPCType victim_kind;
+    // Victim position, stored at 1/100 unit resolution.
+    double x, y;
+};
+
+struct EventLogOptions {
+    std::uint64_t max_bytes = 64ull << 20;
+    std::chrono::milliseconds max_age = std::chrono::hours(1);
+    size_t buffer_bytes = 1 << 20;
+};
+
+// Segment `n` of a log is written to "<base>.<n>.bin" (n zero-padded).
+std::string eventLogSegmentPath(const std::string &base, std::uint64_t segment);
+
+// Binary kill log. Records are delta- and varint-encoded against the
+// previous record, and names are written once per segment the first time
+// an id appears, so every segment decodes on its own. A new segment starts
+// when the current one exceeds max_bytes or max_age. Not thread-safe.
+class EventLogWriter {
+    std::string base_;
+    EventLogOptions opts_;
+    std::ofstream out_;
+    std::string buf_;
+    std::uint64_t segment_ = 0;
+    std::uint64_t segment_bytes_ = 0;
+    std::chrono::steady_clock::time_point opened_at_;
+    std::vector<char> defined_;
+
+    std::uint64_t last_tick_ = 0;
+    std::int64_t last_killer_ = 0, last_victim_ = 0;
+    std::int64_t last_x_ = 0, last_y_ = 0;
+
+    void openSegment();
+    void defineName(NPCId id, std::string_view name);
+    void writeBuffer();
+public:
+    explicit EventLogWriter(std::string base, EventLogOptions opts = {});
+    ~EventLogWriter();
+
+    EventLogWriter(const EventLogWriter&) = delete;
+    EventLogWriter& operator=(const EventLogWriter&) = delete;
+
+    void append(const KillRecord &r, std::string_view killer_name, std::string_view victim_name);
+    void flush();
+    void rotate();
+
+    std::uint64_t segment() const { return segment_; }
+    std::string currentPath() const { return eventLogSegmentPath(base_, segment_); }
+};
+
+class EventLogReader {
+    std::string data_;
+    const char *pos_ = nullptr;
+    const char *end_ = nullptr;
+    std::vector<std::string> names_;
+
+    std::uint64_t last_tick_ = 0;
+    std::int64_t last_killer_ = 0, last_victim_ = 0;
+    std::int64_t last_x_ = 0, last_y_ = 0;
+public:
+    explicit EventLogReader(const std::string &path);
+
+    // Returns false at the end of the segment or at a truncated record.
+    bool next(KillRecord &r);
+    std::string_view name(NPCId id) const;
+};
+
+// Appends every dispatched kill to a binary log; the tick is the battle round.
+// Ids are interned in the observer's own table so logs stay consistent
+// across worlds.
+class BinaryLogObserver : public FightObserver {
+    EventLogWriter writer_;
+    NameTable names_;
+    std::uint64_t round_ = 0;
+public:
+    explicit BinaryLogObserver(const std::string &base, EventLogOptions opts = {});
+    // Name pairs carry no kinds or position, so they cannot be logged;
+    // throws std::logic_error. Every world dispatches through onKills.
+    void onKill(const std::string &killer, const std::string &victim) override;
+    void onKills(std::span<const KillEvent> events) override;
+};
@@ -1,7 +1,18 @@
 #pragma once
 #include "Editor.h"
 #include "NPCFactory.h"
+#include "WorldSnapshot.h"
+#include "SnapshotBuilder.h"
+#include "WorldView.h"
+#include "Scheduler.h"
+#include "EventLog.h"
+#include "Trajectory.h"
+#include "QueryServer.h"
+#include "KillMatrix.h"
+#include "LockstepRules.h"
+#include <array>
 #include <atomic>
+#include <cstdint>
 #include <thread>
 #include <mutex>
 #include <shared_mutex>
@@ -9,6 +20,79 @@
 #include <random>
 #include <vector>
 #include <chrono>
+#include <future>
+#include <string>
+#include <stop_token>
+
+struct GameConfig {
+    // Worker threads for the game's own scheduler. Independent of the number
+    // of tasks (movement, battle, render, logging).
+    unsigned threads = 2;
+    // Optional pool shared between several games; `threads` is then ignored.
+    std::shared_ptr<Scheduler> scheduler;
+    // Binary kill log segments "<event_log>.NNNNNN.bin"; empty disables it.
+    std::string event_log = "game_log";
+    EventLogOptions event_log_options;
+    // Positions streamed to this file once per logging tick (100 ms, or
+    // 100 ms of virtual time in runHeadless) and after each step() (see
+    // TrajectoryRecorder); empty disables recording. A game started again
+    // after stop() appends to the same file.
+    std::string trajectory;
+    TrajectoryOptions trajectory_options;
+    // Print generation and kill messages to stdout.
+    bool verbose = true;
+    // Pin the game's own scheduler threads to these CPUs, round-robin, and
+    // build the world on one of them so its memory is allocated on that
+    // thread's NUMA node. Ignored when `scheduler` is given; pin that pool
+    // through its own constructor instead.
+    std::vector<int> cpus;
+    // runHeadless drives the world with DiscreteEventSim (one pending
+    // action per NPC) instead of replaying the movement and battle ticks.
+    bool discrete_events = false;
+    // runHeadless advances the world in lockstep ticks of 100 ms of virtual
+    // time instead: every tick moves every NPC and then fights one
+    // simultaneous battle, by the LockstepRules a ShardedWorld runs with
+    // the runHeadless seed. Excludes discrete_events.
+    bool lockstep = false;
+    // Work per battle step: sorting one NPC into its species or checking
+    // one pair. A pass over the world that needs more is spread over several
+    // steps, each applying its own kills, so one step's hold on the world
+    // stays bounded however many NPCs there are. 0 runs every pass in a
+    // single step.
+    size_t battle_budget = 0;
+    // Turn tracing on at start() and write a Chrome trace here when the
+    // game stops (see Trace.h); empty disables it. Tracing is process-wide.
+    std::string trace;
+};
+
+// Locality of one NUMA node, see Game::nodeStats.
+struct NodeStats {
+    int node = -1;              // -1 collects floating threads and unknown pages
+    unsigned workers = 0;       // scheduler threads pinned to the node
+    std::uint64_t resumed = 0;  // task resumptions those threads ran
+    size_t npcs = 0;            // living NPCs whose memory is on the node
+};
+
+// Timings of the battle steps, see GameConfig::battle_budget. A step is one
+// slice of a pass, from reading the snapshot to publishing its kills.
+struct BattleSliceStats {
+    std::uint64_t slices = 0;
+    std::uint64_t passes = 0;   // completed sweeps over the world
+    std::uint64_t pairs = 0;    // pair checks over all slices
+    std::chrono::nanoseconds last{0};
+    std::chrono::nanoseconds max{0};
+    std::chrono::nanoseconds total{0};
+};
+
+// Outcome of one Game::runHeadless call.
+struct GameResult {
+    std::uint64_t seed = 0;
+    std::array<int, NPC_TYPE_COUNT> initial{};
+    std::array<int, NPC_TYPE_COUNT> survivors{};
+    // Simulated time until the game ended.
+    std::chrono::milliseconds sim_time{0};
+    bool ended_early = false;
+};
 
 class Game {
 private:
@@ -17,40 +101,194 @@ private:
     mutable std::mutex cout_mutex_;
     
     std::atomic<bool> running_{false};
-    std::atomic<int> alive_count_{0};
+    std::atomic<bool> terminal_{false};
+    std::chrono::steady_clock::time_point started_at_;
+    
+    // Held around every movement and battle step, so pause() returns only
+    // once no step is in flight. Also guards the pause bookkeeping.
+    mutable std::mutex step_mutex_;
+    std::atomic<bool> paused_{false};
+    std::chrono::steady_clock::time_point paused_at_;
+    std::chrono::steady_clock::duration paused_total_{};
+    int initial_count_ = 50;
+    bool resumed_ = false;
+    bool verbose_ = true;
+    bool discrete_events_ = false;
+    bool lockstep_ = false;
     
-    std::thread movement_thread_;
-    std::thread battle_thread_;
-    std::thread main_thread_;
+    std::atomic<SnapshotPtr> snapshot_;
+    // Told about every move and kill so publishSnapshot only replays the
+    // changes instead of copying the world.
+    SnapshotBuilder snapshots_;
+    std::mutex checkpoint_mutex_;
+    std::thread checkpoint_thread_;
+    std::unique_ptr<WorldViewPublisher> world_view_;
+    std::mutex view_mutex_;
+    std::uint64_t viewed_version_ = 0;
+    // Per-version changes for the query server's delta frames.
+    std::unique_ptr<ChangeLog> changes_;
+    std::unique_ptr<QueryServer> query_server_;
+    
+    std::shared_ptr<Scheduler> scheduler_;
+    // Closed while paused; the tasks park on it instead of stepping.
+    Scheduler::Gate pause_gate_;
+    std::stop_source stop_source_;
+    std::mutex tasks_mutex_;
+    std::condition_variable tasks_cv_;
+    int active_tasks_ = 0;
+    
+    std::mutex log_mutex_;
+    std::mutex flush_mutex_;
+    // Kills of one battle round, waiting for the logging task.
+    struct KillRound {
+        std::uint64_t tick;
+        std::vector<KillEvent> events;
+        std::vector<const char*> killer_types;
+    };
+    std::vector<KillRound> pending_rounds_;
+    std::uint64_t battle_round_ = 0;
+    
+    // Battle pass in progress, owned by whoever runs battleStep. The whole
+    // pass fights over the world as of `snap`: NPCs are immutable and a move
+    // swaps in a clone, so an NPC that moves mid-pass still fights where it
+    // stood when the pass started. Kills of NPCs that died since are dropped
+    // when they are applied.
+    struct BattlePass {
+        SnapshotPtr snap;
+        std::array<std::vector<size_t>, NPC_TYPE_COUNT> species;
+        std::array<SpeciesBounds, NPC_TYPE_COUNT> bounds;
+        std::vector<char> killed;
+        // NPCs of `snap` sorted into species so far.
+        size_t indexed = 0;
+        // Cursor: species pair, then row and column within it.
+        size_t pair = 0, x = 0, y = 0;
+    } battle_pass_;
+    size_t battle_budget_ = 0;
+    mutable std::mutex slice_mutex_;
+    BattleSliceStats slice_stats_;
+    std::string event_log_base_;
+    EventLogOptions event_log_options_;
+    std::unique_ptr<EventLogWriter> event_log_;
+    std::unique_ptr<TrajectoryRecorder> trajectory_;
+    std::string trace_path_;
+    bool tracing_ = false;
     
     static constexpr double MOVE_DISTANCE = 5.0;   
     static constexpr double KILL_DISTANCE = 20.0;   
     
     static constexpr double MAP_WIDTH = 100.0;
     static constexpr double MAP_HEIGHT = 100.0;
+    static constexpr int MAP_GRID = 10;
+    static constexpr std::chrono::milliseconds LOCKSTEP_TICK{100};
     
     std::random_device rd_;
     mutable std::mt19937 gen_;
+    std::mt19937 move_gen_;
+    std::mt19937 battle_gen_;
     std::uniform_real_distribution<> pos_dist_;
     std::uniform_int_distribution<> type_dist_;
     
     void generateInitialNPCs();
+    void publishSnapshot();
+    // Copies the latest snapshot into the world view and queues it for the
+    // trajectory. O(population), so it runs once per logging tick instead of
+    // on every change, and skips a world that has not changed since.
+    void publishViews();
     double calculateDistance(double x1, double y1, double x2, double y2) const;
-    void movementWorker();
-    void battleWorker();
-    void mainWorker();
+    void moveStep();
+    void battleStep();
+    void resetBattlePass();
+    void recordSlice(std::chrono::steady_clock::duration took, size_t checked, bool pass_done);
+    void renderMap(int map_updates, std::chrono::steady_clock::duration elapsed);
+    void printGameOver();
+    void flushLog();
+    // Discrete-event body of runHeadless; returns the simulated end time.
+    std::chrono::milliseconds runEvents(std::chrono::milliseconds duration);
+    // Lockstep body of runHeadless; returns the simulated end time.
+    std::chrono::milliseconds runLockstep(std::uint64_t seed, std::chrono::milliseconds duration);
+    // Runs one step unless the game is paused; false if it was skipped.
+    bool runStep(void (Game::*step)());
+    // Wall time since start() minus the time spent paused.
+    std::chrono::steady_clock::duration activeElapsed() const;
+    // True once no two living species can kill each other. Reads only the
+    // lock-free population counters.
+    bool isTerminal() const;
+    
+    // Decrements active_tasks_ when a task's frame is torn down.
+    struct TaskGuard {
+        Game &game;
+        ~TaskGuard();
+    };
+    
+    Task movementTask(std::stop_token stop);
+    Task battleTask(std::stop_token stop);
+    Task renderTask(std::stop_token stop);
+    Task loggingTask(std::stop_token stop);
     
 public:
-    Game();
+    explicit Game(GameConfig config = {});
     ~Game();
     
     Game(const Game&) = delete;
     Game& operator=(const Game&) = delete;
     
-    void start();
+    // Starts the game tasks. With `paused` the simulation does not advance
+    // until resume() or step().
+    void start(bool paused = false);
     void stop();
     void waitForFinish();
     
-    int getAliveCount() const { return alive_count_; }
+    // Freezes movement, battles and the game clock. Returns once no step is
+    // running; rendering and logging of earlier kills continue.
+    void pause();
+    void resume();
+    bool isPaused() const { return paused_; }
+    // Advances a paused game by `ticks` ticks on the calling thread, each one
+    // movement step followed by one battle step. Kills are delivered to the
+    // observers before it returns.
+    void step(int ticks = 1);
+    
+    // Plays a whole game on the calling thread with a virtual clock: the
+    // movement and battle steps fire on the same randomized schedule as the
+    // real tasks (or as discrete events or lockstep ticks, see GameConfig),
+    // but without waiting, until `duration` of simulated time or an early
+    // end. The world is regenerated from `seed`, so equal seeds
+    // give equal results. The game's storage is reused between calls.
+    // Must not be called while the game is running.
+    GameResult runHeadless(std::uint64_t seed,
+                           std::chrono::milliseconds duration = std::chrono::seconds(30));
+    
+    // Writes the latest published snapshot to `path` on a background thread.
+    // Simulation threads are never blocked: the snapshot is taken with a
+    // single atomic load and the file is renamed into place when complete.
+    std::future<void> checkpoint(const std::string &path);
+    // Restores the world from a checkpoint. Must be called before start().
+    void resume(const std::string &path);
+    
+    // Observers receive one onKills batch per battle round from the logging
+    // task. Must be called before start().
+    void addObserver(ObsPtr obs);
+    
+    // Publishes the latest snapshot into the POSIX shared-memory segment
+    // `name` for external viewers (see WorldViewReader) every logging tick
+    // (100 ms) and after each step(). Must be called before start().
+    void enableWorldView(const std::string &name, std::uint32_t capacity = 4096);
+    
+    // Serves snapshot, stats, region and subscribe queries on the Unix
+    // socket `path` (see QueryServer) until the game is destroyed. Must be
+    // called before start().
+    void enableQueryServer(const std::string &path, QueryServerOptions opts = {});
+    
+    SnapshotPtr snapshot() const { return snapshot_.load(); }
+    
+    int getAliveCount() const { return editor_.stats().total(); }
+    // True if the game stopped before its time limit because no more kills
+    // were possible.
+    bool endedEarly() const { return terminal_; }
+    const PopulationStats& stats() const { return editor_.stats(); }
+    // Per NUMA node, ordered by node. Worker counts and resumptions cover the
+    // whole scheduler, which may be shared with other games.
+    std::vector<NodeStats> nodeStats() const;
+    BattleSliceStats battleSlices() const;
     const Editor& getEditor() const { return editor_; }
 };
\ No newline at end of file
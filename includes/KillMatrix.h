@@ -0,0 +1,56 @@
+#pragma once
+#include "NPC.h"
+#include "FightVisitor.h"
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <utility>
+#include <vector>
+
+// Species-level view of a rule set: whether any `attacker` type kills any
+// `defender` type. Built by running the rules once on prototype NPCs, so it
+// always agrees with the visitor it was derived from (the rules must depend
+// only on the two types, as FightRules does).
+class KillMatrix {
+    std::array<std::array<bool, NPC_TYPE_COUNT>, NPC_TYPE_COUNT> kills_{};
+    // Unordered species pairs (first <= second) where at least one side can kill.
+    std::vector<std::pair<NPCType, NPCType>> pairs_;
+
+    static std::size_t slot(NPCType t) { return static_cast<std::size_t>(t); }
+public:
+    explicit KillMatrix(FightVisitor &rules);
+
+    // Matrix for FightRules, built on first use.
+    static const KillMatrix& standard();
+
+    bool kills(NPCType attacker, NPCType defender) const { return kills_[slot(attacker)][slot(defender)]; }
+    bool interacts(NPCType a, NPCType b) const { return kills(a, b) || kills(b, a); }
+    const std::vector<std::pair<NPCType, NPCType>>& interactingPairs() const { return pairs_; }
+
+    // False once no living pair of species can kill each other: the
+    // population can never change again.
+    bool canKill(const std::array<int, NPC_TYPE_COUNT> &counts) const;
+};
+
+// Axis-aligned bounds of a group of NPCs. If two species' bounds are more
+// than the battle distance apart, no pair between them can be in range.
+struct SpeciesBounds {
+    double min_x = std::numeric_limits<double>::infinity();
+    double min_y = std::numeric_limits<double>::infinity();
+    double max_x = -std::numeric_limits<double>::infinity();
+    double max_y = -std::numeric_limits<double>::infinity();
+
+    void add(double x, double y) {
+        min_x = std::min(min_x, x);
+        min_y = std::min(min_y, y);
+        max_x = std::max(max_x, x);
+        max_y = std::max(max_y, y);
+    }
+    bool empty() const { return min_x > max_x; }
+    // Squared gap between the two boxes (0 if they overlap).
+    double gap2(const SpeciesBounds &o) const {
+        double dx = std::max({0.0, o.min_x - max_x, min_x - o.max_x});
+        double dy = std::max({0.0, o.min_y - max_y, min_y - o.max_y});
+        return dx*dx + dy*dy;
+    }
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include "Editor.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct LockstepOptions {
+    std::uint64_t seed = 1;
+    double move_distance = 5.0;
+    double kill_distance = 20.0;
+    double width = 100.0;
+    double height = 100.0;
+};
+
+struct LockstepKill {
+    NPCHandle killer, victim;
+};
+
+// Rules of a world advanced in lockstep ticks, shared by Game's lockstep
+// mode (GameConfig::lockstep) and the shards of a ShardedWorld. A tick moves
+// every NPC by up to move_distance per axis and then attacks every NPC with
+// those within kill_distance that can kill it: the first attacker by name
+// to win its dice roll kills it. Kills are simultaneous, decided on the
+// positions after the move, and each victim dies once.
+//
+// Every draw is a hash of (seed, tick, NPC names) instead of the next value
+// of a generator, so a process holding only part of the world rolls the
+// same dice for its NPCs as one holding all of it.
+class LockstepRules {
+    LockstepOptions opts_;
+public:
+    explicit LockstepRules(LockstepOptions opts = {});
+
+    const LockstepOptions& options() const { return opts_; }
+
+    // Moves every NPC of `world` for `tick`, calling `moved` for each one.
+    void move(Editor &world, int tick, const std::function<void(NPCHandle)> &moved = {}) const;
+    // Kills of `tick`, ordered by victim name. Only NPCs accepted by
+    // `victim` (all if empty) are attacked, but all of them attack. The
+    // world is left unchanged.
+    std::vector<LockstepKill> battle(const Editor &world, int tick,
+                                     const std::function<bool(NPCHandle)> &victim = {}) const;
+};
@@ -1,10 +1,24 @@
 #pragma once
+#include <cstddef>
 #include <string>
 #include <memory>
 #include <ostream>
 
 class FightVisitor;
 
+enum class NPCType { Bear, Bittern, Desman };
+constexpr std::size_t NPC_TYPE_COUNT = 3;
+
+// Same spelling as NPC::type() and the save file format.
+constexpr const char* npcTypeName(NPCType type) {
+    switch (type) {
+        case NPCType::Bear:    return "Bear";
+        case NPCType::Bittern: return "Bittern";
+        case NPCType::Desman:  return "Desman";
+    }
+    return "Unknown";
+}
+
 class NPC {
 protected:
     std::string name_;
@@ -20,6 +34,7 @@ public:
     double y() const { return y_; }
 
     virtual std::string type() const = 0;
+    virtual NPCType kind() const = 0;
 
     virtual bool accept(FightVisitor &visitor, NPC &defender) = 0;
 
@@ -2,8 +2,6 @@
 #include "NPC.h"
 #include <istream>
 
-enum class NPCType { Bear, Bittern, Desman };
-
 class NPCFactory {
 public:
     static NPCPtr create(NPCType type, const std::string &name, double x, double y);
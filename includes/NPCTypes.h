@@ -5,6 +5,7 @@ class Bear : public NPC {
 public:
     Bear(const std::string &n, double x, double y) : NPC(n, x, y) {}
     std::string type() const override { return "Bear"; }
+    NPCType kind() const override { return NPCType::Bear; }
     bool accept(FightVisitor &v, NPC &defender) override;
     
     std::shared_ptr<NPC> cloneWithPosition(double x, double y) const override {
@@ -16,6 +17,7 @@ class Bittern : public NPC {
 public:
     Bittern(const std::string &n, double x, double y) : NPC(n, x, y) {}
     std::string type() const override { return "Bittern"; }
+    NPCType kind() const override { return NPCType::Bittern; }
     bool accept(FightVisitor &v, NPC &defender) override;
     
     std::shared_ptr<NPC> cloneWithPosition(double x, double y) const override {
@@ -27,6 +29,7 @@ class Desman : public NPC {
 public:
     Desman(const std::string &n, double x, double y) : NPC(n, x, y) {}
     std::string type() const override { return "Desman"; }
+    NPCType kind() const override { return NPCType::Desman; }
     bool accept(FightVisitor &v, NPC &defender) override;
     
     std::shared_ptr<NPC> cloneWithPosition(double x, double y) const override {
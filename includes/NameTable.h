@@ -0,0 +1,28 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+using NPCId = std::uint32_t;
+constexpr NPCId INVALID_NPC_ID = std::numeric_limits<NPCId>::max();
+
+// Per-world string table. Each distinct name gets a dense 32-bit id; names
+// are stored once and resolved back to text only when producing output.
+class NameTable {
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, NPCId> ids_;
+public:
+    NameTable() = default;
+    NameTable(const NameTable &other);
+    NameTable(NameTable&&) = default;
+    NameTable& operator=(NameTable other) noexcept;
+
+    NPCId intern(std::string_view name);
+    NPCId find(std::string_view name) const;
+
+    const std::string& name(NPCId id) const { return names_[id]; }
+    size_t size() const { return names_.size(); }
+};
@@ -1,11 +1,30 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <memory>
+#include <span>
 #include <vector>
+#include "NameTable.h"
+#include "NPC.h"
+
+struct KillEvent {
+    NPCId killer;
+    NPCId victim;
+    NPCType killer_kind = NPCType::Bear;
+    NPCType victim_kind = NPCType::Bear;
+    // Victim position at the time of the kill.
+    double x = 0, y = 0;
+    // Views into the world's NameTable, filled in just before dispatch.
+    std::string_view killer_name = {};
+    std::string_view victim_name = {};
+};
 
 class FightObserver {
 public:
     virtual void onKill(const std::string &killer, const std::string &victim) = 0;
+    // Called once per battle round with every kill of that round. The
+    // default forwards each event to onKill.
+    virtual void onKills(std::span<const KillEvent> events);
     virtual ~FightObserver() = default;
 };
 
@@ -14,6 +33,7 @@ using ObsPtr = std::shared_ptr<FightObserver>;
 class ConsoleObserver : public FightObserver {
 public:
     void onKill(const std::string &killer, const std::string &victim) override;
+    void onKills(std::span<const KillEvent> events) override;
 };
 
 class FileObserver : public FightObserver {
@@ -21,4 +41,5 @@ class FileObserver : public FightObserver {
 public:
     explicit FileObserver(const std::string &fname = "log.txt");
     void onKill(const std::string &killer, const std::string &victim) override;
-};
\ No newline at end of file
+    void onKills(std::span<const KillEvent> events) override;
+};
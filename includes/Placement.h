@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// Linux CPU and NUMA placement helpers. They talk to the kernel directly
+// (sched affinity, sysfs and move_pages), so no libnuma is needed; on
+// kernels without NUMA support everything reports node 0 or -1.
+
+// CPUs the calling process is allowed to run on.
+std::vector<int> allowedCpus();
+
+// Restricts the calling thread to one CPU. Returns false on failure.
+bool pinCurrentThread(int cpu);
+
+// CPU the calling thread is running on right now, or -1.
+int currentCpu();
+
+// NUMA node a CPU belongs to; 0 when the kernel exposes no topology.
+int numaNodeOfCpu(int cpu);
+
+// NUMA node of the page holding each address, written to `nodes`, or -1
+// where a page is not resident or the kernel cannot tell. Only queries;
+// nothing is migrated.
+void numaNodesOf(std::span<const void* const> addrs, std::span<int> nodes);
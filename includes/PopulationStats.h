@@ -0,0 +1,56 @@
+#pragma once
+#include "NPC.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Live population counters, updated in O(1) by the owning Editor on every
+// spawn, kill and move. Writers are serialized by the owner; readers may
+// query from any thread without locking and see each counter's latest value
+// (counters are independent, so a reader racing a kill may briefly see the
+// per-type and per-region numbers one event apart).
+class PopulationStats {
+    std::array<std::atomic<int>, NPC_TYPE_COUNT> by_type_{};
+    std::atomic<int> total_{0};
+
+    // Optional cols x rows grid of per-type counters over [0,width]x[0,height].
+    int cols_ = 0;
+    int rows_ = 0;
+    double width_ = 0;
+    double height_ = 0;
+    std::vector<std::atomic<int>> regions_;
+
+    static std::size_t slot(NPCType t) { return static_cast<std::size_t>(t); }
+    int regionOf(double x, double y) const;
+    void bump(NPCType t, double x, double y, int delta);
+
+public:
+    PopulationStats() = default;
+    PopulationStats(const PopulationStats&) = delete;
+    PopulationStats& operator=(const PopulationStats&) = delete;
+
+    void onSpawn(NPCType t, double x, double y) { bump(t, x, y, +1); }
+    void onKill(NPCType t, double x, double y) { bump(t, x, y, -1); }
+    void onMove(NPCType t, double from_x, double from_y, double to_x, double to_y);
+    void clear();
+
+    // Turns on per-region counting. Existing counts are reset; the owner is
+    // expected to replay its population (see Editor::enableRegionStats).
+    // Not safe against concurrent readers, so call before sharing.
+    void enableRegions(int cols, int rows, double width, double height);
+
+    int count(NPCType t) const { return by_type_[slot(t)].load(std::memory_order_relaxed); }
+    int total() const { return total_.load(std::memory_order_relaxed); }
+    std::array<int, NPC_TYPE_COUNT> counts() const {
+        std::array<int, NPC_TYPE_COUNT> out{};
+        for (std::size_t t = 0; t < NPC_TYPE_COUNT; ++t) out[t] = by_type_[t].load(std::memory_order_relaxed);
+        return out;
+    }
+
+    bool hasRegions() const { return cols_ > 0; }
+    int regionCols() const { return cols_; }
+    int regionRows() const { return rows_; }
+    int regionCount(int col, int row, NPCType t) const;
+    int regionCount(int col, int row) const;
+};
@@ -0,0 +1,116 @@
+#pragma once
+#include "ChangeLog.h"
+#include "PopulationStats.h"
+#include "WorldSnapshot.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct QueryServerOptions {
+    // A subscriber gets a full KEY frame at least this many versions apart,
+    // and deltas in between.
+    std::uint64_t keyframe_interval = 64;
+};
+
+// Local query service on a Unix stream socket. One epoll thread serves
+// every client. It reads only the published snapshots and the lock-free
+// population counters, so the simulation never waits on a client.
+//
+// Requests are text lines; NPC rows are "<id> <type> <name> <x> <y>":
+//   STATS                 -> "STATS <version> <alive> <bears> <bitterns> <desmans>"
+//   SNAPSHOT              -> "SNAPSHOT <version> <n>" followed by n rows
+//   REGION x0 y0 x1 y1    -> "REGION <version> <n>" followed by the n rows
+//                            inside the box
+//   SUBSCRIBE             -> a KEY frame now, then one frame for each newer
+//                            version (see below); a client still reading the
+//                            previous frame skips straight to the latest
+//   QUIT                  -> closes the connection
+// Anything else is answered with "ERR <reason>".
+//
+// Subscription frames:
+//   KEY <version> <n>     followed by n NPC rows: the whole world
+//   DELTA <from> <to> <moved> <removed> <spawned>
+//                         followed by "<id> <x100> <y100>" per moved NPC
+//                         (positions in hundredths), "<id>" per removed NPC
+//                         and an NPC row per spawned one. Applied to the
+//                         world at <from> it gives the world at <to>.
+// Deltas come from the ChangeLog; without one, or when it no longer covers
+// the range, a KEY frame is sent instead.
+class QueryServer {
+    struct Client {
+        std::string in;
+        std::string out;
+        size_t sent = 0;
+        bool waiting_writable = false;
+        bool subscribed = false;
+        std::uint64_t last_version = 0;
+        std::uint64_t last_key = 0;
+        bool closing = false;
+    };
+
+    std::string path_;
+    const std::atomic<SnapshotPtr> &snapshot_;
+    const PopulationStats &stats_;
+    const ChangeLog *changes_;
+    QueryServerOptions opts_;
+
+    int listen_fd_ = -1;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    std::atomic<bool> wake_pending_{false};
+    std::atomic<bool> stopping_{false};
+    std::atomic<size_t> client_count_{0};
+    std::atomic<std::uint64_t> key_frames_{0};
+    std::atomic<std::uint64_t> delta_frames_{0};
+    std::atomic<std::uint64_t> bytes_sent_{0};
+    std::thread thread_;
+
+    // Owned by the server thread.
+    std::unordered_map<int, Client> clients_;
+    // Frames of frame_snap_, built on first use.
+    SnapshotPtr frame_snap_;
+    std::string rows_;
+    std::string frame_;
+    std::string key_frame_;
+    std::vector<std::int32_t> index_;  // NPCId -> row in frame_snap_, or -1
+    std::unordered_map<std::uint64_t, std::string> deltas_;  // by base version
+    ChangeLog::Changes scratch_;
+
+    void run();
+    void accept();
+    void readFrom(int fd, Client &c);
+    void handle(Client &c, const std::string &line);
+    bool send(int fd, Client &c, const std::string &data);
+    void flush(int fd, Client &c);
+    void publishToSubscribers();
+    // Moves frame_snap_ to the latest snapshot, dropping the frame caches
+    // if it changed. The frame builders below work on frame_snap_.
+    void refresh();
+    const std::string& snapshotFrame();
+    const std::string& keyFrame();
+    // The next frame for a subscriber at c.last_version, updating it.
+    const std::string& subscriberFrame(Client &c);
+    void close(int fd);
+public:
+    // Listens on `path`, replacing a stale socket file.
+    QueryServer(const std::string &path, const std::atomic<SnapshotPtr> &snapshot, const PopulationStats &stats,
+                const ChangeLog *changes = nullptr, QueryServerOptions opts = {});
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // Tells the server a new snapshot was published. Cheap and lock-free;
+    // bursts of calls wake the server thread once.
+    void notify();
+
+    const std::string& path() const { return path_; }
+    size_t clientCount() const { return client_count_; }
+    std::uint64_t keyFrames() const { return key_frames_; }
+    std::uint64_t deltaFrames() const { return delta_frames_; }
+    std::uint64_t bytesSent() const { return bytes_sent_; }
+};
@@ -0,0 +1,66 @@
+#pragma once
+#include "NPC.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Helpers for the parallel save/load paths of Editor. The on-disk format is
+// the one NPC::serialize writes: "Type name x y\n" per NPC.
+
+// Read-only private mapping of a whole file; empty files map to an empty view.
+class MappedFile {
+    void *data_ = nullptr;
+    std::size_t size_ = 0;
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    std::string_view view() const { return {static_cast<const char*>(data_), size_}; }
+};
+
+// Runs fn(0) .. fn(tasks - 1), each on its own thread (the last one on the
+// calling thread), and waits for all of them.
+void parallelFor(std::size_t tasks, const std::function<void(std::size_t)> &fn);
+
+// Splits `text` into at most `parts` non-empty pieces of similar size, each
+// ending just after a newline (or at the end of the text).
+std::vector<std::string_view> splitLines(std::string_view text, std::size_t parts);
+
+// Number of whitespace separated tokens in `text`.
+std::size_t countTokens(std::string_view text);
+
+// Like splitLines, but every piece holds whole "type name x y" records even
+// where a record spans lines: the lines' tokens are counted in parallel and
+// each cut is moved past the end of the record open at it. A trailing
+// partial record stays in the last piece.
+std::vector<std::string_view> splitRecords(std::string_view text, std::size_t parts);
+
+struct NPCRecord {
+    NPCType type;
+    std::string_view name;
+    double x, y;
+};
+
+// Appends every whitespace separated "type name x y" record of `text` to
+// `out`. Type names are case-insensitive. Throws std::runtime_error with the
+// same messages as NPCFactory::loadFromStream on malformed input; the
+// records before the bad one are left in `out`.
+void parseNPCRecords(std::string_view text, std::vector<NPCRecord> &out);
+
+// Appends npc's record exactly as NPC::serialize would print it (doubles in
+// the default ostream "%g" style with precision 6), without iostreams or
+// allocating the type() string.
+void appendNPCRecord(std::string &out, const NPC &npc);
+
+// Writes `npcs` (null entries are skipped) to `path`: records are formatted
+// into per-thread buffers over equal slices of the array, written with a single
+// gathered writev to "<path>.tmp", fsynced, renamed into place and the
+// directory fsynced, so readers, and the file after a crash or power loss,
+// are either the old file or the complete new one. `threads` == 0 picks one
+// per core for large arrays. Throws std::runtime_error on I/O failure.
+void writeNPCFile(const std::vector<NPCPtr> &npcs, const std::string &path, unsigned threads = 0);
@@ -0,0 +1,164 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fire-and-forget coroutine. It starts when handed to Scheduler::spawn and
+// destroys its own frame when it returns.
+class Task {
+public:
+    struct promise_type {
+        Task get_return_object() { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    Task(Task &&other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    Task& operator=(Task&&) = delete;
+    ~Task() { if (handle_) handle_.destroy(); }
+
+    std::coroutine_handle<> release() { return std::exchange(handle_, {}); }
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle_(h) {}
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// Small thread pool that runs coroutine tasks and wakes them from timers.
+// Any number of Game instances can share one Scheduler.
+class Scheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+private:
+    struct TimerState {
+        std::coroutine_handle<> handle;
+        std::atomic<bool> fired{false};
+        // Reaches zero once both the setup in await_suspend and the first
+        // fire (deadline or stop request) are done; exactly one of them resumes.
+        std::atomic<int> gate{2};
+    };
+    using TimerPtr = std::shared_ptr<TimerState>;
+
+    struct Timer {
+        Clock::time_point deadline;
+        TimerPtr state;
+        bool operator>(const Timer &o) const { return deadline > o.deadline; }
+    };
+
+    struct Waker {
+        Scheduler *scheduler;
+        TimerPtr state;
+        void operator()() const { scheduler->fire(state); }
+    };
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<std::coroutine_handle<>> ready_;
+    std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers_;
+    bool stopping_ = false;
+
+    struct Worker {
+        int cpu = -1;
+        int node = -1;
+        std::atomic<std::uint64_t> resumed{0};
+    };
+    std::vector<Worker> workers_;
+    std::vector<std::thread> threads_;
+
+    void post(std::coroutine_handle<> h);
+    void fire(const TimerPtr &state);
+    void release(const TimerPtr &state);
+    void addTimer(Clock::time_point deadline, TimerPtr state);
+    void workerLoop(size_t index);
+
+public:
+    class SleepAwaiter {
+        Scheduler &scheduler_;
+        Clock::time_point deadline_;
+        std::stop_token token_;
+        TimerPtr state_;
+        std::optional<std::stop_callback<Waker>> callback_;
+    public:
+        SleepAwaiter(Scheduler &s, Clock::time_point deadline, std::stop_token token)
+            : scheduler_(s), deadline_(deadline), token_(std::move(token)) {}
+
+        bool await_ready() const { return token_.stop_requested(); }
+        void await_suspend(std::coroutine_handle<> h);
+        // True if the full duration elapsed, false if a stop was requested.
+        bool await_resume() {
+            callback_.reset();
+            return !token_.stop_requested();
+        }
+    };
+
+    // Parks coroutines until it is opened; starts open. A stop request does
+    // not wake parked coroutines by itself, so whoever requests the stop
+    // must also open the gate.
+    class Gate {
+        Scheduler &scheduler_;
+        std::mutex mutex_;
+        bool open_ = true;
+        std::vector<std::coroutine_handle<>> waiters_;
+    public:
+        explicit Gate(Scheduler &s) : scheduler_(s) {}
+
+        void open();
+        void close();
+
+        class Awaiter {
+            Gate &gate_;
+            std::stop_token token_;
+        public:
+            Awaiter(Gate &g, std::stop_token token) : gate_(g), token_(std::move(token)) {}
+
+            bool await_ready() const { return token_.stop_requested(); }
+            bool await_suspend(std::coroutine_handle<> h);
+            // True if the gate opened, false if a stop was requested.
+            bool await_resume() const { return !token_.stop_requested(); }
+        };
+        Awaiter wait(std::stop_token token) { return Awaiter(*this, std::move(token)); }
+    };
+
+    struct WorkerStats {
+        int cpu;     // pinned CPU, or -1 if the thread floats
+        int node;    // NUMA node of that CPU, or -1
+        std::uint64_t resumed;  // coroutine resumptions run by the thread
+    };
+
+    // With `cpus`, worker i is pinned to cpus[i % cpus.size()]; every CPU
+    // must be one the process may run on.
+    explicit Scheduler(unsigned threads, std::vector<int> cpus = {});
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    void spawn(Task task);
+    SleepAwaiter sleepFor(Clock::duration d, std::stop_token token) {
+        return SleepAwaiter(*this, Clock::now() + d, std::move(token));
+    }
+
+    unsigned threadCount() const { return static_cast<unsigned>(threads_.size()); }
+    bool pinned() const { return !workers_.empty() && workers_.front().cpu >= 0; }
+    std::vector<WorkerStats> workerStats() const;
+
+    // Runs fn on a worker thread and waits for it, so memory that fn touches
+    // first lands on that worker's NUMA node. Exceptions are rethrown here.
+    // Must not be called from a worker thread.
+    void runOnWorker(const std::function<void()> &fn);
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include "NPC.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct ShardRegion {
+    double x0, y0, x1, y1;
+
+    double distanceTo(double x, double y) const;
+    double distanceToEdge(double x, double y) const;
+};
+
+// Splits a width x height map into cols x rows rectangular shards.
+class ShardLayout {
+    int cols_, rows_;
+    double width_, height_;
+public:
+    ShardLayout(int cols, int rows, double width, double height);
+
+    int count() const { return cols_ * rows_; }
+    double width() const { return width_; }
+    double height() const { return height_; }
+    int ownerOf(double x, double y) const;
+    ShardRegion region(int shard) const;
+    // Shards sharing an edge or a corner with `shard`, in index order.
+    std::vector<int> neighbours(int shard) const;
+};
+
+// A sharded run plays by LockstepRules over the layout's map, the same rules
+// as Game::runHeadless in lockstep mode: with Game's distances, its map and
+// the seed passed to runHeadless it reproduces that game tick for tick.
+struct ShardOptions {
+    std::uint64_t seed = 1;
+    int ticks = 100;
+    double move_distance = 5.0;
+    double kill_distance = 20.0;
+};
+
+struct ShardKill {
+    int tick;
+    std::string killer, victim;
+
+    bool operator==(const ShardKill&) const = default;
+};
+
+struct ShardRunResult {
+    // In the order of the NPCs passed in.
+    std::vector<NPCPtr> survivors;
+    // Ordered by tick, then victim name, like Game's lockstep kill rounds.
+    std::vector<ShardKill> kills;
+    // NPCs handed from one shard to another.
+    std::uint64_t migrations = 0;
+};
+
+// Runs a world for a number of ticks with every shard in its own forked
+// process, holding its NPCs in an Editor. A tick moves every NPC, hands NPCs
+// that crossed into another region to that shard, sends each neighbour the
+// NPCs within kill distance of its region (its ghost zone), and then lets
+// every shard resolve the deaths of the NPCs it owns with
+// LockstepRules::battle. Shards talk to their neighbours directly over Unix
+// domain socket pairs; the calling process only hands out the initial NPCs
+// and collects the results.
+//
+// Every region must be wider and taller than both the move and the kill
+// distance, so migrants and ghosts only ever go to neighbours, and the map
+// must fit in an Editor's world.
+class ShardedWorld {
+    ShardLayout layout_;
+    ShardOptions opts_;
+public:
+    ShardedWorld(ShardLayout layout, ShardOptions opts);
+
+    ShardRunResult run(const std::vector<NPCPtr> &npcs) const;
+    // The same run as a single shard in this process. run() must produce
+    // exactly the same result.
+    ShardRunResult runInProcess(const std::vector<NPCPtr> &npcs) const;
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+struct SlotHandle {
+    static constexpr std::uint32_t NONE = std::numeric_limits<std::uint32_t>::max();
+
+    std::uint32_t index = NONE;
+    std::uint32_t generation = 0;
+
+    bool operator==(const SlotHandle &o) const = default;
+};
+
+// Dense, insertion-ordered storage addressed by generational handles.
+// erase() only leaves a tombstone (O(1)) and bumps the slot generation, so
+// any handle to the erased value becomes detectably stale. compact() drops
+// the tombstones in one order-preserving pass; handles stay valid across it.
+template <typename T>
+class SlotMap {
+    struct Slot {
+        std::uint32_t dense = SlotHandle::NONE;
+        std::uint32_t generation = 0;
+    };
+
+    std::vector<Slot> slots_;
+    std::vector<std::uint32_t> free_;
+    std::vector<T> values_;
+    std::vector<SlotHandle> handles_;
+    size_t tombstones_ = 0;
+
+public:
+    SlotHandle insert(T value) {
+        std::uint32_t index;
+        if (!free_.empty()) {
+            index = free_.back();
+            free_.pop_back();
+        } else {
+            index = static_cast<std::uint32_t>(slots_.size());
+            slots_.emplace_back();
+        }
+        Slot &slot = slots_[index];
+        slot.dense = static_cast<std::uint32_t>(values_.size());
+        values_.push_back(std::move(value));
+        handles_.push_back({index, slot.generation});
+        return handles_.back();
+    }
+
+    bool contains(SlotHandle h) const {
+        return h.index < slots_.size() &&
+               slots_[h.index].generation == h.generation &&
+               slots_[h.index].dense != SlotHandle::NONE;
+    }
+
+    T* get(SlotHandle h) { return contains(h) ? &values_[slots_[h.index].dense] : nullptr; }
+    const T* get(SlotHandle h) const { return contains(h) ? &values_[slots_[h.index].dense] : nullptr; }
+
+    bool erase(SlotHandle h) {
+        if (!contains(h)) return false;
+        Slot &slot = slots_[h.index];
+        values_[slot.dense] = T{};
+        handles_[slot.dense] = SlotHandle{};
+        slot.dense = SlotHandle::NONE;
+        ++slot.generation;
+        free_.push_back(h.index);
+        ++tombstones_;
+        return true;
+    }
+
+    void compact() {
+        if (tombstones_ == 0) return;
+        size_t out = 0;
+        for (size_t d = 0; d < values_.size(); ++d) {
+            if (handles_[d].index == SlotHandle::NONE) continue;
+            if (out != d) {
+                values_[out] = std::move(values_[d]);
+                handles_[out] = handles_[d];
+            }
+            slots_[handles_[out].index].dense = static_cast<std::uint32_t>(out);
+            ++out;
+        }
+        values_.resize(out);
+        handles_.resize(out);
+        tombstones_ = 0;
+    }
+
+    // Compacts once tombstones exceed a quarter of the dense array, so the
+    // cost is amortised over many erasures.
+    bool compactIfSparse() {
+        if (tombstones_ * 4 <= values_.size()) return false;
+        compact();
+        return true;
+    }
+
+    // Old handles stay invalid, but slots are handed out again in index
+    // order as in a fresh map, so a refilled map does not depend on its past.
+    void clear() {
+        for (auto &h : handles_) {
+            if (h.index == SlotHandle::NONE) continue;
+            slots_[h.index].dense = SlotHandle::NONE;
+            ++slots_[h.index].generation;
+        }
+        free_.resize(slots_.size());
+        for (size_t i = 0; i < slots_.size(); ++i)
+            free_[i] = static_cast<std::uint32_t>(slots_.size() - 1 - i);
+        values_.clear();
+        handles_.clear();
+        tombstones_ = 0;
+    }
+
+    size_t size() const { return values_.size() - tombstones_; }
+    size_t tombstones() const { return tombstones_; }
+
+    // Dense arrays; a tombstone has a default value and an invalid handle.
+    const std::vector<T>& values() const { return values_; }
+    const std::vector<SlotHandle>& handles() const { return handles_; }
+};
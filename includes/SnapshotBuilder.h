@@ -0,0 +1,67 @@
+#pragma once
+#include "Editor.h"
+#include "WorldSnapshot.h"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+// Produces the WorldSnapshots a Game publishes without copying the world
+// for every change. The owner reports each move and kill (under its world
+// lock); build() takes a spare snapshot that no reader holds any more and
+// replays only the changes it has missed since it was last published, so
+// publishing costs O(changes) instead of O(population). Removing an NPC
+// moves the snapshot's last entry into its place, so snapshot order is
+// stable between kills but is not the Editor's order.
+//
+// Not thread-safe; calls are serialized by the owner's world lock.
+class SnapshotBuilder {
+    struct Op {
+        enum Kind : std::uint8_t { Set, Remove } kind;
+        std::uint32_t pos;
+        // Version of the first snapshot that contains the change.
+        std::uint64_t version;
+        NPCPtr npc;
+    };
+
+    // Layout of the next snapshot: handle at each position, and position
+    // of each live handle by slot index.
+    std::vector<SlotHandle> order_;
+    std::vector<std::uint32_t> pos_;
+    std::deque<Op> ops_;
+    // Spares at or above this version can be brought up to date from ops_.
+    std::uint64_t floor_ = 0;
+
+    std::shared_ptr<WorldSnapshot> current_;
+    std::vector<std::shared_ptr<WorldSnapshot>> spares_;
+    // Whole world captured by reset(), published by the next build().
+    std::shared_ptr<WorldSnapshot> staged_;
+    std::uint64_t full_copies_ = 0;
+
+    static constexpr size_t MAX_SPARES = 3;
+    // Changes kept for spares pinned by slow readers; beyond this a spare
+    // is refilled by a full copy instead.
+    static constexpr size_t MIN_KEPT_OPS = 4096;
+
+    static void apply(WorldSnapshot &snap, const Op &op);
+    void trim();
+public:
+    SnapshotBuilder();
+
+    // Restarts from the editor's whole world, e.g. after it was generated or
+    // loaded. O(population).
+    void reset(const Editor &editor);
+
+    void moved(SlotHandle h, NPCPtr npc);
+    void removed(SlotHandle h);
+
+    // The next snapshot, version current()->version + 1, holding every
+    // change reported so far. The previous one becomes a spare.
+    std::shared_ptr<WorldSnapshot> build();
+    // Last built snapshot (version 0 and empty before the first build).
+    const std::shared_ptr<WorldSnapshot>& current() const { return current_; }
+
+    // Builds that had to copy a whole snapshot because no spare could be
+    // brought up to date.
+    std::uint64_t fullCopies() const { return full_copies_; }
+};
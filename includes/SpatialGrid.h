@@ -0,0 +1,129 @@
+#pragma once
+#include "SlotMap.h"
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Uniform bucket grid over [0,width]x[0,height] keyed by SlotHandle. Points
+// outside the area are clamped into the border cells. Insert, move and erase
+// are O(1); queries only visit the cells overlapping the search area and
+// never allocate.
+class SpatialGrid {
+    struct Entry {
+        SlotHandle handle;
+        double x, y;
+    };
+    struct Locator {
+        std::uint32_t cell = NO_CELL;
+        std::uint32_t pos = 0;
+    };
+    static constexpr std::uint32_t NO_CELL = 0xFFFFFFFFu;
+
+    double cell_;
+    int cols_, rows_;
+    std::vector<std::vector<Entry>> cells_;
+    std::vector<Locator> where_;  // by slot index
+    std::size_t size_ = 0;
+
+    int colOf(double x) const { return std::clamp(static_cast<int>(x / cell_), 0, cols_ - 1); }
+    int rowOf(double y) const { return std::clamp(static_cast<int>(y / cell_), 0, rows_ - 1); }
+    std::uint32_t cellOf(double x, double y) const {
+        return static_cast<std::uint32_t>(rowOf(y) * cols_ + colOf(x));
+    }
+    const Entry& entry(SlotHandle h) const {
+        const Locator &l = where_[h.index];
+        return cells_[l.cell][l.pos];
+    }
+    void unlink(const Locator &l);
+
+public:
+    SpatialGrid(double width, double height, double cell);
+
+    void insert(SlotHandle h, double x, double y);
+    void move(SlotHandle h, double x, double y);
+    void erase(SlotHandle h);
+    void clear();
+
+    bool contains(SlotHandle h) const {
+        return h.index < where_.size() && where_[h.index].cell != NO_CELL && entry(h).handle == h;
+    }
+    std::size_t size() const { return size_; }
+    double cellSize() const { return cell_; }
+
+    // fn(SlotHandle, x, y) for every point inside the closed box.
+    template <class Fn>
+    void forEachInBox(double x0, double y0, double x1, double y1, Fn &&fn) const {
+        if (x0 > x1 || y0 > y1) return;
+        for (int r = rowOf(y0), r1 = rowOf(y1); r <= r1; ++r) {
+            for (int c = colOf(x0), c1 = colOf(x1); c <= c1; ++c) {
+                for (const Entry &e : cells_[r * cols_ + c]) {
+                    if (e.x >= x0 && e.x <= x1 && e.y >= y0 && e.y <= y1)
+                        fn(e.handle, e.x, e.y);
+                }
+            }
+        }
+    }
+
+    // fn(SlotHandle, x, y) for every point within distance r of (x, y).
+    template <class Fn>
+    void forEachInRadius(double x, double y, double r, Fn &&fn) const {
+        const double r2 = r * r;
+        forEachInBox(x - r, y - r, x + r, y + r, [&](SlotHandle h, double px, double py) {
+            double dx = px - x, dy = py - y;
+            if (dx*dx + dy*dy <= r2) fn(h, px, py);
+        });
+    }
+
+    // Writes the out.size() nearest points accepted by pred(SlotHandle) into
+    // `out`, closest first, and returns how many were found. Searches rings
+    // of cells outward and stops once the next ring cannot beat the current
+    // k-th distance.
+    template <class Pred>
+    std::size_t nearestK(double x, double y, std::span<SlotHandle> out, Pred &&pred) const {
+        if (out.empty()) return 0;
+
+        auto d2 = [&](SlotHandle h) {
+            const Entry &e = entry(h);
+            double dx = e.x - x, dy = e.y - y;
+            return dx*dx + dy*dy;
+        };
+        auto farther = [&](SlotHandle a, SlotHandle b) { return d2(a) < d2(b); };
+
+        const int cx = colOf(x), cy = rowOf(y);
+        const int max_ring = std::max({cx, cols_ - 1 - cx, cy, rows_ - 1 - cy});
+        std::size_t found = 0;
+
+        for (int ring = 0; ring <= max_ring; ++ring) {
+            for (int r = cy - ring; r <= cy + ring; ++r) {
+                if (r < 0 || r >= rows_) continue;
+                bool edge_row = r == cy - ring || r == cy + ring;
+                int step = edge_row ? 1 : 2 * ring;
+                for (int c = cx - ring; c <= cx + ring; c += step) {
+                    if (c < 0 || c >= cols_) continue;
+                    for (const Entry &e : cells_[r * cols_ + c]) {
+                        if (!pred(e.handle)) continue;
+                        if (found < out.size()) {
+                            out[found++] = e.handle;
+                            std::push_heap(out.begin(), out.begin() + found, farther);
+                        } else if (d2(e.handle) < d2(out.front())) {
+                            std::pop_heap(out.begin(), out.end(), farther);
+                            out.back() = e.handle;
+                            std::push_heap(out.begin(), out.end(), farther);
+                        }
+                    }
+                }
+            }
+
+            if (found == out.size()) {
+                // Distance from (x, y) to the outside of the searched block.
+                double bound = std::min({x - (cx - ring) * cell_, (cx + ring + 1) * cell_ - x,
+                                         y - (cy - ring) * cell_, (cy + ring + 1) * cell_ - y});
+                if (bound > 0 && bound * bound >= d2(out.front())) break;
+            }
+        }
+
+        std::sort_heap(out.begin(), out.begin() + found, farther);
+        return found;
+    }
+};
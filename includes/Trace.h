@@ -0,0 +1,67 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Scoped trace markers, recorded into per-thread ring buffers and exported
+// as Chrome trace-event JSON (chrome://tracing or ui.perfetto.dev).
+//
+// TRACE_SCOPE compiles to nothing unless LAB7_TRACING is defined (CMake
+// option LAB7_TRACING, on by default). Compiled in, recording still has to
+// be switched on with traceEnable(); while it is off a marker costs one
+// relaxed atomic load.
+
+// Events kept per thread; the oldest are overwritten first. A thread's
+// ring outlives it until its events are exported or cleared, and is then
+// reused by a later thread; at most a few exited threads' rings are kept.
+constexpr size_t TRACE_RING_CAPACITY = 1 << 14;
+
+extern std::atomic<bool> g_trace_enabled;
+
+inline bool traceEnabled() { return g_trace_enabled.load(std::memory_order_relaxed); }
+void traceEnable(bool on);
+// Drops every buffered event. Safe while threads are recording.
+void traceClear();
+// Names the calling thread in exported traces.
+void traceThreadName(const std::string &name);
+// Buffered events over all threads.
+size_t traceEventCount();
+// Rings allocated so far, in use or waiting for reuse.
+size_t traceBufferCount();
+// Writes all buffered events to `path`. Safe while threads are recording:
+// each ring is copied up to the events published when the copy started,
+// and events overwritten during the copy are left out. Exited threads'
+// rings are released afterwards.
+void writeChromeTrace(const std::string &path);
+
+std::uint64_t traceNowNs();
+// `name` must outlive the export; TRACE_SCOPE passes string literals.
+void traceRecord(const char *name, std::uint64_t start_ns, std::uint64_t end_ns);
+
+class TraceScope {
+    const char *name_ = nullptr;
+    std::uint64_t start_ = 0;
+public:
+    explicit TraceScope(const char *name) {
+        if (traceEnabled()) {
+            name_ = name;
+            start_ = traceNowNs();
+        }
+    }
+    ~TraceScope() {
+        if (name_) traceRecord(name_, start_, traceNowNs());
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define LAB7_TRACE_CONCAT2(a, b) a##b
+#define LAB7_TRACE_CONCAT(a, b) LAB7_TRACE_CONCAT2(a, b)
+
+#ifdef LAB7_TRACING
+#define TRACE_SCOPE(name) TraceScope LAB7_TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name) ((void)0)
+#endif
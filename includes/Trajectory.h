@@ -0,0 +1,112 @@
+#pragma once
+#include "NPC.h"
+#include "NameTable.h"
+#include "WorldSnapshot.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct TrajectoryOptions {
+    // Ticks buffered per row group; bounds the recorder's working memory to
+    // one group of encoded columns.
+    size_t ticks_per_group = 64;
+    // Snapshots waiting for the writer thread. When full, new ticks are
+    // dropped (and counted) instead of stalling the simulation.
+    size_t max_queued = 256;
+};
+
+// Streams every recorded snapshot's positions to a columnar file.
+//
+// File: "L7TR" + version, then row groups, each prefixed with its byte
+// length. A group holds up to ticks_per_group ticks and is self-contained:
+// columns tick, count, names, id, kind, x, y, each prefixed with its byte
+// length so readers can skip the ones they don't need. Ticks are delta
+// encoded, ids delta encoded within a tick, and coordinates (1/100 unit)
+// delta encoded against the same NPC's previous row in the group; all as
+// zigzag varints.
+class TrajectoryRecorder {
+    std::string path_;
+    std::ofstream out_;
+    TrajectoryOptions opts_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<SnapshotPtr> queue_;
+    bool closing_ = false;
+    std::atomic<std::uint64_t> recorded_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+    std::thread writer_;
+
+    // Current row group, owned by the writer thread.
+    struct Columns {
+        std::string tick, count, names, id, kind, x, y;
+        size_t ticks = 0;
+        size_t rows = 0;
+    } group_;
+    std::uint64_t last_tick_ = 0;
+    std::uint32_t group_no_ = 0;
+    struct Last {
+        std::uint32_t group = 0;
+        std::int64_t x = 0, y = 0;
+    };
+    std::vector<Last> last_;  // by NPCId
+
+    void run();
+    void encode(const WorldSnapshot &snap);
+    void writeGroup();
+public:
+    explicit TrajectoryRecorder(const std::string &path, TrajectoryOptions opts = {});
+    ~TrajectoryRecorder();
+
+    TrajectoryRecorder(const TrajectoryRecorder&) = delete;
+    TrajectoryRecorder& operator=(const TrajectoryRecorder&) = delete;
+
+    // Queues a snapshot for the writer thread without waiting on I/O.
+    // Returns false if it was dropped because the queue is full or closed.
+    bool record(SnapshotPtr snap);
+    // Drains the queue, writes the last partial group, joins the writer and
+    // closes the file.
+    void close();
+    // Starts recording again after close(), appending row groups to the same
+    // file. Does nothing while the recorder is open.
+    void reopen();
+
+    std::uint64_t recorded() const { return recorded_; }
+    std::uint64_t dropped() const { return dropped_; }
+};
+
+struct TrajectoryRow {
+    NPCId id;
+    NPCType kind;
+    double x, y;
+};
+
+struct TrajectoryTick {
+    std::uint64_t tick = 0;
+    std::vector<TrajectoryRow> rows;
+};
+
+// Reads a trajectory file one row group at a time.
+class TrajectoryReader {
+    std::ifstream in_;
+    std::vector<TrajectoryTick> group_;
+    size_t next_ = 0;
+    std::unordered_map<NPCId, std::string> names_;
+
+    bool readGroup();
+public:
+    explicit TrajectoryReader(const std::string &path);
+
+    // Returns false at the end of the file or at a truncated group.
+    bool next(TrajectoryTick &tick);
+    // Names of every NPC seen so far.
+    std::string_view name(NPCId id) const;
+};
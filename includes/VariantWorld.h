@@ -0,0 +1,55 @@
+#pragma once
+#include "NPCTypes.h"
+#include "NameTable.h"
+#include "Observer.h"
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+using NPCValue = std::variant<Bear, Bittern, Desman>;
+
+// Compile-time counterpart of FightRules. std::visit over two NPCValues
+// instantiates one inlinable kernel per attacker/defender combination.
+struct StaticFightRules {
+    bool operator()(const Bear&, const Bear&) const { return false; }
+    template <typename Defender>
+    bool operator()(const Bear&, const Defender&) const { return true; }
+
+    template <typename Defender>
+    bool operator()(const Bittern&, const Defender&) const { return false; }
+
+    bool operator()(const Desman&, const Bear&) const { return true; }
+    template <typename Defender>
+    bool operator()(const Desman&, const Defender&) const { return false; }
+};
+
+// Value-type world: NPCs are stored contiguously by value instead of behind
+// shared_ptr. The polymorphic API is available through at() and toNPCs().
+class VariantWorld {
+    std::vector<NPCValue> npcs_;
+    std::vector<ObsPtr> observers_;
+    // Ids for KillEvents, interned as NPCs first appear in a kill.
+    NameTable names_;
+public:
+    VariantWorld() = default;
+    explicit VariantWorld(const std::vector<NPCPtr> &npcs);
+
+    void addObserver(ObsPtr obs);
+
+    void add(const NPC &npc);
+    void add(NPCValue npc) { npcs_.push_back(std::move(npc)); }
+
+    size_t size() const { return npcs_.size(); }
+    const NPCValue& operator[](size_t i) const { return npcs_[i]; }
+    const NPC& at(size_t i) const {
+        return std::visit([](const auto &n) -> const NPC& { return n; }, npcs_[i]);
+    }
+
+    std::vector<NPCPtr> toNPCs() const;
+
+    // Same semantics as Editor::runBattle: species that cannot hurt each
+    // other are skipped and each round's kills reach observers as one
+    // onKills batch.
+    void runBattle(double distance);
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include "NPC.h"
+#include "NameTable.h"
+#include "SlotMap.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Immutable view of the world published by Game after every mutation.
+// NPCs are never modified in place (movement swaps in a clone), so sharing
+// the pointers is enough to keep the snapshot consistent.
+struct WorldSnapshot {
+    std::uint64_t version = 0;
+    std::vector<NPCPtr> npcs;
+    std::vector<NPCId> ids;
+    // Generational handles into the Editor; stale once the NPC has died.
+    std::vector<SlotHandle> handles;
+};
+
+using SnapshotPtr = std::shared_ptr<const WorldSnapshot>;
@@ -0,0 +1,90 @@
+#pragma once
+#include "WorldSnapshot.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// POSIX shared-memory ring of world frames. The publisher writes each frame
+// under a per-frame sequence counter (odd while writing), so readers in
+// other processes can read in place without any lock on the simulation.
+// Frames hold living NPCs only, so an entry needs no alive flag.
+struct WorldViewEntry {
+    float x, y;
+    std::uint8_t type;
+    std::uint8_t reserved[3];
+};
+
+struct WorldViewFrame {
+    std::atomic<std::uint64_t> seq;
+    std::uint64_t tick;
+    // Entries stored, at most the ring's capacity.
+    std::uint32_t count;
+    // NPCs in the world; greater than `count` when the frame was cut off.
+    std::uint32_t population;
+
+    bool truncated() const { return population > count; }
+
+    // `count` entries are stored directly after the frame header.
+    const WorldViewEntry* entries() const { return reinterpret_cast<const WorldViewEntry*>(this + 1); }
+    WorldViewEntry* entries() { return reinterpret_cast<WorldViewEntry*>(this + 1); }
+};
+
+struct WorldViewHeader {
+    std::uint32_t magic;
+    std::uint32_t frame_count;
+    std::uint32_t capacity;
+    std::uint32_t frame_bytes;
+    std::atomic<std::uint64_t> latest_tick;
+};
+
+class WorldViewPublisher {
+    std::string name_;
+    void *base_ = nullptr;
+    size_t size_ = 0;
+    WorldViewHeader *header_ = nullptr;
+    std::uint64_t tick_ = 0;
+public:
+    WorldViewPublisher(const std::string &name, std::uint32_t capacity, std::uint32_t frames = 8);
+    ~WorldViewPublisher();
+
+    WorldViewPublisher(const WorldViewPublisher&) = delete;
+    WorldViewPublisher& operator=(const WorldViewPublisher&) = delete;
+
+    // Worlds larger than the capacity are cut off; the frame still records
+    // the full population, see WorldViewFrame::truncated.
+    void publish(const WorldSnapshot &snap);
+    std::uint64_t tick() const { return tick_; }
+    std::uint32_t capacity() const { return header_->capacity; }
+};
+
+class WorldViewReader {
+    void *base_ = nullptr;
+    size_t size_ = 0;
+    const WorldViewHeader *header_ = nullptr;
+
+    const WorldViewFrame* frame(std::uint64_t tick) const;
+public:
+    explicit WorldViewReader(const std::string &name);
+    ~WorldViewReader();
+
+    WorldViewReader(const WorldViewReader&) = delete;
+    WorldViewReader& operator=(const WorldViewReader&) = delete;
+
+    std::uint64_t latestTick() const;
+
+    // Calls fn(const WorldViewFrame&) on the latest frame directly in shared
+    // memory. Returns false if the frame was overwritten while fn ran, in
+    // which case anything fn computed must be discarded.
+    template <typename Fn>
+    bool visitLatest(Fn &&fn) const {
+        std::uint64_t tick = latestTick();
+        if (tick == 0) return false;
+        const WorldViewFrame *f = frame(tick);
+        std::uint64_t before = f->seq.load(std::memory_order_acquire);
+        if (before & 1) return false;
+        fn(*f);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return f->seq.load(std::memory_order_relaxed) == before && f->tick == tick;
+    }
+};
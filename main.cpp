@@ -2,6 +2,7 @@
 #include "Editor.h"
 #include "NPCFactory.h"
 #include "Observer.h"
+#include "EventLog.h"
 #include <iostream>
 #include <sstream>
 #include <algorithm>
@@ -18,7 +19,7 @@ std::string trim(const std::string &s) {
 void runEditor() {
     Editor ed;
     ed.addObserver(std::make_shared<ConsoleObserver>());
-    ed.addObserver(std::make_shared<FileObserver>("log.txt"));
+    ed.addObserver(std::make_shared<BinaryLogObserver>("log"));
 
     while (true) {
         std::cout << "\n=== Dungeon Editor (Lab 6) ===\n";
@@ -122,19 +123,51 @@ void runEditor() {
     }
 }
 
-void runMultiThreadedGame() {
+// Optional outputs of the game, all off unless asked for on the command line.
+struct GameOutputs {
+    std::string trajectory;
+    std::string trace;
+    std::string world_view;
+    std::string query_socket;
+};
+
+void runMultiThreadedGame(const GameOutputs &outputs) {
     std::cout << "\n=== Multi-threaded NPC Game (Lab Work #7) ===" << std::endl;
     std::cout << "Based on Lab 6 Variant 19: Bear, Bittern (Выпь), Desman (Выхухоль)" << std::endl;
     std::cout << "Using Desman (Выхухоль) parameters: Move=5, Kill=20" << std::endl;
     std::cout << "=============================================" << std::endl;
     
     try {
-        Game game;
+        GameConfig config;
+        config.trajectory = outputs.trajectory;
+        config.trace = outputs.trace;
+        Game game(config);
+        if (!outputs.trajectory.empty())
+            std::cout << "Recording trajectories to " << outputs.trajectory << " (run Lab7_trajectory_dump)" << std::endl;
+        if (!outputs.trace.empty())
+            std::cout << "Chrome trace written to " << outputs.trace << " on exit (open in ui.perfetto.dev)" << std::endl;
+        if (!outputs.world_view.empty()) {
+            try {
+                game.enableWorldView(outputs.world_view);
+                std::cout << "Live world view: " << outputs.world_view << " (run Lab7_worldview_reader)" << std::endl;
+            } catch (const std::exception& e) {
+                std::cout << "World view disabled: " << e.what() << std::endl;
+            }
+        }
+        if (!outputs.query_socket.empty()) {
+            try {
+                game.enableQueryServer(outputs.query_socket);
+                std::cout << "Query server: " << outputs.query_socket << " (run Lab7_query)" << std::endl;
+            } catch (const std::exception& e) {
+                std::cout << "Query server disabled: " << e.what() << std::endl;
+            }
+        }
         
-        std::cout << "\nGame will run for 30 seconds with 3 threads:" << std::endl;
-        std::cout << "1. Movement thread (moves NPCs randomly)" << std::endl;
-        std::cout << "2. Battle thread (handles fights with dice rolls)" << std::endl;
-        std::cout << "3. Main thread (prints map every second)" << std::endl;
+        std::cout << "\nGame will run for up to 30 seconds (less if no more kills are possible) with 4 coroutine tasks:" << std::endl;
+        std::cout << "1. Movement task (moves NPCs randomly)" << std::endl;
+        std::cout << "2. Battle task (handles fights with dice rolls)" << std::endl;
+        std::cout << "3. Logging task (prints and logs kills)" << std::endl;
+        std::cout << "4. Render task (prints map every second)" << std::endl;
         std::cout << "\nPress Enter to start the game..." << std::endl;
         std::cin.ignore(1000, '\n');
         
@@ -152,7 +185,26 @@ void runMultiThreadedGame() {
     }
 }
 
-int main() {
+// Usage: Lab7 [--trajectory FILE] [--trace FILE] [--world-view NAME] [--query SOCKET]
+// e.g. --trajectory trajectory.bin --trace trace.json --world-view /lab7_world
+//      --query /tmp/lab7_query.sock
+int main(int argc, char **argv) {
+    GameOutputs outputs;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        std::string *value = nullptr;
+        if (arg == "--trajectory") value = &outputs.trajectory;
+        else if (arg == "--trace") value = &outputs.trace;
+        else if (arg == "--world-view") value = &outputs.world_view;
+        else if (arg == "--query") value = &outputs.query_socket;
+        if (!value || i + 1 == argc) {
+            std::cerr << "Usage: " << argv[0]
+                      << " [--trajectory FILE] [--trace FILE] [--world-view NAME] [--query SOCKET]" << std::endl;
+            return 1;
+        }
+        *value = argv[++i];
+    }
+    
     std::srand(static_cast<unsigned int>(std::time(nullptr)));
     
     while (true) {
@@ -169,7 +221,7 @@ int main() {
         if (choice == 0) {
             break;
         } else if (choice == 1) {
-            runMultiThreadedGame();
+            runMultiThreadedGame(outputs);
         } else if (choice == 2) {
             runEditor();
         } else {
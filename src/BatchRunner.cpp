@@ -0,0 +1,130 @@
+#include "BatchRunner.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+std::vector<GameResult> runBatch(const BatchOptions &opts) {
+    std::vector<GameResult> results(opts.runs);
+    if (opts.runs == 0) return results;
+
+    unsigned threads = opts.threads ? opts.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, opts.runs));
+
+    // Headless games never spawn tasks; one idle pool thread is shared by
+    // all of them instead of each Game starting its own.
+    auto idle = std::make_shared<Scheduler>(1);
+    std::atomic<size_t> next{0};
+    // A failing run stops the batch; the error is rethrown once every
+    // worker has been joined.
+    std::vector<std::exception_ptr> errors(threads);
+
+    auto worker = [&](unsigned t) {
+        try {
+            GameConfig config;
+            config.scheduler = idle;
+            config.event_log.clear();
+            config.verbose = false;
+            config.discrete_events = opts.discrete_events;
+            Game game(config);
+
+            for (size_t i = next++; i < opts.runs; i = next++)
+                results[i] = game.runHeadless(opts.base_seed + i, opts.duration);
+        } catch (...) {
+            errors[t] = std::current_exception();
+            next = opts.runs;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker, t);
+    worker(0);
+    for (auto &t : pool) t.join();
+    for (auto &e : errors)
+        if (e) std::rethrow_exception(e);
+    return results;
+}
+
+static SurvivalStats describe(std::vector<double> &rates) {
+    SurvivalStats s;
+    s.samples = rates.size();
+    if (rates.empty()) return s;
+
+    std::sort(rates.begin(), rates.end());
+    double sum = 0;
+    for (double r : rates) sum += r;
+    s.mean = sum / static_cast<double>(rates.size());
+    double var = 0;
+    for (double r : rates) var += (r - s.mean) * (r - s.mean);
+    s.stddev = std::sqrt(var / static_cast<double>(rates.size()));
+
+    // Nearest-rank percentiles.
+    auto pct = [&](double p) {
+        size_t rank = static_cast<size_t>(std::ceil(p * static_cast<double>(rates.size())));
+        return rates[std::clamp<size_t>(rank, 1, rates.size()) - 1];
+    };
+    s.min = rates.front();
+    s.p5 = pct(0.05);
+    s.p50 = pct(0.50);
+    s.p95 = pct(0.95);
+    s.max = rates.back();
+    return s;
+}
+
+BatchSummary summarizeBatch(const std::vector<GameResult> &results) {
+    BatchSummary summary;
+    summary.runs = results.size();
+
+    std::array<std::vector<double>, NPC_TYPE_COUNT> species;
+    std::vector<double> overall;
+    double sim_seconds = 0;
+    for (const auto &r : results) {
+        int initial = 0, survivors = 0;
+        for (size_t t = 0; t < NPC_TYPE_COUNT; ++t) {
+            initial += r.initial[t];
+            survivors += r.survivors[t];
+            if (r.initial[t] > 0)
+                species[t].push_back(static_cast<double>(r.survivors[t]) / r.initial[t]);
+        }
+        if (initial > 0) overall.push_back(static_cast<double>(survivors) / initial);
+        if (r.ended_early) ++summary.ended_early;
+        sim_seconds += std::chrono::duration<double>(r.sim_time).count();
+    }
+
+    for (size_t t = 0; t < NPC_TYPE_COUNT; ++t) summary.species[t] = describe(species[t]);
+    summary.overall = describe(overall);
+    if (!results.empty()) summary.mean_sim_seconds = sim_seconds / static_cast<double>(results.size());
+    return summary;
+}
+
+void writeBatchSummary(const BatchSummary &summary, const std::string &path) {
+    std::ofstream out(path);
+    if (!out) throw std::runtime_error("Cannot open batch summary: " + path);
+
+    out << "=== Batch Summary ===\n";
+    out << "Runs: " << summary.runs << '\n';
+    out << "Ended early: " << summary.ended_early << '\n';
+    out << std::fixed << std::setprecision(2);
+    out << "Mean game time: " << summary.mean_sim_seconds << " s\n";
+    out << "\nSurvival rate (%)\n";
+    out << std::left << std::setw(10) << "species" << std::right
+        << std::setw(8) << "samples" << std::setw(8) << "mean" << std::setw(8) << "stddev"
+        << std::setw(8) << "min" << std::setw(8) << "p5" << std::setw(8) << "p50"
+        << std::setw(8) << "p95" << std::setw(8) << "max" << '\n';
+
+    auto row = [&](const char *label, const SurvivalStats &s) {
+        out << std::left << std::setw(10) << label << std::right << std::setw(8) << s.samples;
+        for (double v : {s.mean, s.stddev, s.min, s.p5, s.p50, s.p95, s.max})
+            out << std::setw(8) << v * 100.0;
+        out << '\n';
+    };
+    for (size_t t = 0; t < NPC_TYPE_COUNT; ++t) row(npcTypeName(static_cast<NPCType>(t)), summary.species[t]);
+    row("All", summary.overall);
+
+    if (!out) throw std::runtime_error("Failed to write batch summary: " + path);
+}
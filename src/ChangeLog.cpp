@@ -0,0 +1,47 @@
+#include "ChangeLog.h"
+#include <algorithm>
+
+void ChangeLog::commit(std::uint64_t version) {
+    pending_.version = version;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (entries_.size() >= capacity_) {
+        // Recycle the oldest entry's buffers for the next pending one.
+        Entry oldest = std::move(entries_.front());
+        entries_.pop_front();
+        entries_.push_back(std::move(pending_));
+        pending_ = std::move(oldest);
+        pending_.changes.moved.clear();
+        pending_.changes.removed.clear();
+        pending_.changes.spawned.clear();
+    } else {
+        entries_.push_back(std::move(pending_));
+        pending_ = {};
+    }
+    pending_.reset = false;
+}
+
+bool ChangeLog::collect(std::uint64_t from, std::uint64_t to, Changes &out) const {
+    out.moved.clear();
+    out.removed.clear();
+    out.spawned.clear();
+    if (from >= to) return from == to;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Versions are committed in order and consecutively.
+    if (entries_.empty() || entries_.front().version > from + 1 || entries_.back().version < to) return false;
+
+    auto first = entries_.begin() + static_cast<std::ptrdiff_t>(from + 1 - entries_.front().version);
+    for (auto it = first; it != entries_.end() && it->version <= to; ++it) {
+        if (it->reset) return false;
+        const Changes &c = it->changes;
+        out.moved.insert(out.moved.end(), c.moved.begin(), c.moved.end());
+        out.removed.insert(out.removed.end(), c.removed.begin(), c.removed.end());
+        out.spawned.insert(out.spawned.end(), c.spawned.begin(), c.spawned.end());
+    }
+
+    for (auto *ids : {&out.moved, &out.removed, &out.spawned}) {
+        std::sort(ids->begin(), ids->end());
+        ids->erase(std::unique(ids->begin(), ids->end()), ids->end());
+    }
+    return true;
+}
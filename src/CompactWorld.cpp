@@ -0,0 +1,211 @@
+#include "CompactWorld.h"
+#include "NPCFactory.h"
+#include "KillMatrix.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+
+template <typename Coord>
+static constexpr double coordMax() {
+    constexpr std::uint64_t limit = std::min<std::uint64_t>(std::numeric_limits<Coord>::max(), 0x7FFFFFFFu);
+    return static_cast<double>(limit);
+}
+
+template <typename Coord>
+CompactWorld<Coord>::CompactWorld(double extent)
+    : extent_(extent), scale_(coordMax<Coord>() / extent) {
+    if (extent <= 0) throw std::invalid_argument("Invalid world extent");
+}
+
+template <typename Coord>
+CompactWorld<Coord>::CompactWorld(const std::vector<NPCPtr> &npcs, double extent)
+    : CompactWorld(extent) {
+    xs_.reserve(npcs.size());
+    ys_.reserve(npcs.size());
+    kinds_.reserve(npcs.size());
+    names_.reserve(npcs.size());
+    for (auto &n : npcs) {
+        if (n && !add(*n))
+            throw std::runtime_error("NPC outside compact world: " + n->name());
+    }
+}
+
+template <typename Coord>
+void CompactWorld<Coord>::addObserver(ObsPtr obs) {
+    observers_.push_back(obs);
+}
+
+template <typename Coord>
+Coord CompactWorld<Coord>::quantize(double v) const {
+    return static_cast<Coord>(std::llround(v * scale_));
+}
+
+template <typename Coord>
+bool CompactWorld<Coord>::add(NPCType type, std::string_view name, double x, double y) {
+    if (!(x >= 0 && x <= extent_ && y >= 0 && y <= extent_)) return false;
+
+    xs_.push_back(quantize(x));
+    ys_.push_back(quantize(y));
+    kinds_.push_back(static_cast<std::uint8_t>(type));
+    names_.push_back(table_.intern(name));
+    return true;
+}
+
+template <typename Coord>
+double CompactWorld<Coord>::tolerance() const {
+    return std::sqrt(2.0) * step();
+}
+
+template <typename Coord>
+size_t CompactWorld<Coord>::memoryBytes() const {
+    return xs_.capacity() * sizeof(Coord) + ys_.capacity() * sizeof(Coord) +
+           kinds_.capacity() * sizeof(std::uint8_t) + names_.capacity() * sizeof(NPCId);
+}
+
+template <typename Coord>
+std::vector<NPCPtr> CompactWorld<Coord>::toNPCs() const {
+    std::vector<NPCPtr> out;
+    out.reserve(size());
+    for (size_t i = 0; i < size(); ++i)
+        out.push_back(NPCFactory::create(kind(i), std::string(name(i)), x(i), y(i)));
+    return out;
+}
+
+template <typename Coord>
+void CompactWorld<Coord>::sortByX() {
+    std::vector<std::uint32_t> order(size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](std::uint32_t a, std::uint32_t b) { return xs_[a] < xs_[b]; });
+
+    auto permute = [&](auto &column) {
+        std::remove_reference_t<decltype(column)> sorted;
+        sorted.reserve(column.size());
+        for (auto i : order) sorted.push_back(column[i]);
+        column.swap(sorted);
+    };
+    permute(xs_);
+    permute(ys_);
+    permute(kinds_);
+    permute(names_);
+}
+
+template <typename Coord>
+void CompactWorld<Coord>::runBattle(double distance) {
+    const KillMatrix &matrix = KillMatrix::standard();
+    // Anything beyond sqrt(2) * coordMax covers the whole world; clamping
+    // keeps reach^2 inside 64 bits.
+    const double reach = std::min(distance * scale_, 1.5 * coordMax<Coord>());
+    const std::int64_t qd = static_cast<std::int64_t>(std::floor(reach));
+    const std::uint64_t qd2 = static_cast<std::uint64_t>(std::floor(reach * reach));
+
+    // Terminal: no two living species can hurt each other.
+    std::array<int, NPC_TYPE_COUNT> counts{};
+    for (auto k : kinds_) ++counts[k];
+    if (!matrix.canKill(counts)) return;
+
+    // Sorted by x, the partners of i within range are a contiguous run after
+    // it, and so is every species list built from the sorted order.
+    sortByX();
+
+    // Positions of each species, ascending, and their bounds in the integer
+    // coordinates (exact in a double, since they fit in 31 bits).
+    std::array<std::vector<std::uint32_t>, NPC_TYPE_COUNT> species;
+    std::array<SpeciesBounds, NPC_TYPE_COUNT> bounds;
+    const size_t n = size();
+    for (std::uint32_t i = 0; i < n; ++i) {
+        species[kinds_[i]].push_back(i);
+        bounds[kinds_[i]].add(xs_[i], ys_[i]);
+    }
+    // gap2 rounds once its squares pass 2^53; the slack keeps a pair at
+    // exactly qd2 from being pruned.
+    const double prune2 = static_cast<double>(qd2) * (1 + 0x1p-40);
+
+    auto inRange = [&](std::uint32_t i, std::uint32_t j) {
+        std::int64_t dx = static_cast<std::int64_t>(xs_[j]) - xs_[i];
+        std::int64_t dy = static_cast<std::int64_t>(ys_[j]) - ys_[i];
+        if (dy > qd || dy < -qd) return false;
+        return static_cast<std::uint64_t>(dx * dx) + static_cast<std::uint64_t>(dy * dy) <= qd2;
+    };
+
+    // Single pass, for the reason given at Editor::runBattle. `order` is the
+    // same pair key Editor uses, so kills come out in x-sorted pair order
+    // whatever order the species pairs run in.
+    struct Kill {
+        std::uint64_t order;
+        std::uint32_t killer, victim;
+    };
+    std::vector<Kill> kills;
+
+    for (auto [a, b] : matrix.interactingPairs()) {
+        const auto &A = species[static_cast<size_t>(a)];
+        const auto &B = species[static_cast<size_t>(b)];
+        if (A.empty() || B.empty()) continue;
+        if (bounds[static_cast<size_t>(a)].gap2(bounds[static_cast<size_t>(b)]) > prune2) continue;
+
+        const bool a_kills_b = matrix.kills(a, b);
+        const bool b_kills_a = matrix.kills(b, a);
+
+        auto fight = [&](std::uint32_t i, std::uint32_t j, bool i_kills_j, bool j_kills_i) {
+            if (!inRange(i, j)) return;
+            std::uint64_t pair = i < j ? (std::uint64_t{i} << 32 | j) : (std::uint64_t{j} << 32 | i);
+            if (i_kills_j) kills.push_back({pair << 1 | (i > j), i, j});
+            if (j_kills_i) kills.push_back({pair << 1 | (j > i), j, i});
+        };
+
+        if (a == b) {
+            for (size_t p = 0; p < A.size(); ++p)
+                for (size_t q = p + 1; q < A.size(); ++q) {
+                    if (static_cast<std::int64_t>(xs_[A[q]]) - xs_[A[p]] > qd) break;
+                    fight(A[p], A[q], a_kills_b, a_kills_b);
+                }
+        } else {
+            // Both lists are x-sorted: B's window around each i only slides right.
+            size_t lo = 0;
+            for (std::uint32_t i : A) {
+                while (lo < B.size() && static_cast<std::int64_t>(xs_[i]) - xs_[B[lo]] > qd) ++lo;
+                for (size_t q = lo; q < B.size(); ++q) {
+                    if (static_cast<std::int64_t>(xs_[B[q]]) - xs_[i] > qd) break;
+                    fight(i, B[q], a_kills_b, b_kills_a);
+                }
+            }
+        }
+    }
+    if (kills.empty()) return;
+
+    std::sort(kills.begin(), kills.end(), [](const Kill &l, const Kill &r) { return l.order < r.order; });
+    std::vector<char> dead(n, 0);
+    std::vector<KillEvent> events;
+    events.reserve(kills.size());
+    for (const Kill &k : kills) {
+        dead[k.victim] = 1;
+        events.push_back({.killer = names_[k.killer], .victim = names_[k.victim],
+                          .killer_kind = kind(k.killer), .victim_kind = kind(k.victim),
+                          .x = x(k.victim), .y = y(k.victim)});
+    }
+
+    for (auto &e : events) {
+        e.killer_name = table_.name(e.killer);
+        e.victim_name = table_.name(e.victim);
+    }
+    for (auto &o : observers_) o->onKills(events);
+
+    size_t out = 0;
+    for (size_t i = 0; i < n; ++i) {
+        if (dead[i]) continue;
+        xs_[out] = xs_[i];
+        ys_[out] = ys_[i];
+        kinds_[out] = kinds_[i];
+        names_[out] = names_[i];
+        ++out;
+    }
+    xs_.resize(out);
+    ys_.resize(out);
+    kinds_.resize(out);
+    names_.resize(out);
+}
+
+template class CompactWorld<std::uint16_t>;
+template class CompactWorld<std::uint32_t>;
@@ -0,0 +1,108 @@
+#include "DiscreteEventSim.h"
+#include "KillMatrix.h"
+#include <algorithm>
+#include <stdexcept>
+
+DiscreteEventSim::DiscreteEventSim(Editor &editor, std::uint64_t seed, DiscreteEventOptions opts)
+    : editor_(editor), opts_(opts), gen_(static_cast<std::mt19937::result_type>(seed ^ (seed >> 32))) {
+    if (opts_.min_delay.count() <= 0 || opts_.max_delay < opts_.min_delay)
+        throw std::invalid_argument("Invalid action delays");
+
+    // First actions are spread over one full delay so the NPCs start out
+    // of phase.
+    std::uniform_int_distribution<std::int64_t> first(0, opts_.max_delay.count());
+    for (const auto &h : editor_.handles()) {
+        if (editor_.find(h)) schedule(h, std::chrono::milliseconds(first(gen_)));
+    }
+}
+
+void DiscreteEventSim::schedule(NPCHandle h, std::chrono::milliseconds after) {
+    queue_.push({now_ + after, seq_++, h});
+}
+
+void DiscreteEventSim::add(NPCHandle h) {
+    std::uniform_int_distribution<std::int64_t> delay(opts_.min_delay.count(), opts_.max_delay.count());
+    schedule(h, std::chrono::milliseconds(delay(gen_)));
+}
+
+std::chrono::milliseconds DiscreteEventSim::nextTime() const {
+    return queue_.empty() ? std::chrono::milliseconds::max() : queue_.top().time;
+}
+
+bool DiscreteEventSim::step(std::vector<KillEvent> &kills, const std::function<void(NPCHandle)> &moved) {
+    // Actions of NPCs that died since they were scheduled are dropped here.
+    NPCPtr actor;
+    Event ev{};
+    while (!actor) {
+        if (queue_.empty()) return false;
+        ev = queue_.top();
+        queue_.pop();
+        actor = editor_.find(ev.npc);
+    }
+    now_ = ev.time;
+    ++stats_.actions;
+
+    std::uniform_real_distribution<> move_dist(-opts_.move_distance, opts_.move_distance);
+    double x = std::clamp(actor->x() + move_dist(gen_), 0.0, opts_.width);
+    double y = std::clamp(actor->y() + move_dist(gen_), 0.0, opts_.height);
+    if (editor_.moveNPC(ev.npc, x, y)) {
+        actor = editor_.find(ev.npc);
+        if (moved) moved(ev.npc);
+    }
+
+    const KillMatrix &matrix = KillMatrix::standard();
+    neighbours_.clear();
+    editor_.queryRadius(actor->x(), actor->y(), opts_.kill_distance, [&](NPCHandle h, const NPC &npc) {
+        if (h != ev.npc && matrix.interacts(actor->kind(), npc.kind())) neighbours_.push_back(h);
+    });
+    // Grid order is arbitrary; fight in handle order so runs are repeatable.
+    std::sort(neighbours_.begin(), neighbours_.end(), [](NPCHandle a, NPCHandle b) {
+        return a.index != b.index ? a.index < b.index : a.generation < b.generation;
+    });
+
+    std::uniform_int_distribution<> dice(1, 6);
+    const NPCId actor_id = editor_.idOf(ev.npc);
+    bool actor_dead = false;
+    for (NPCHandle h : neighbours_) {
+        if (actor_dead) break;
+        NPCPtr other = editor_.find(h);
+        if (!other) continue;
+        ++stats_.checks;
+
+        int attack = dice(gen_), defense = dice(gen_);
+        int counter = dice(gen_), guard = dice(gen_);
+        bool actor_kills = matrix.kills(actor->kind(), other->kind()) && attack > defense;
+        bool other_kills = matrix.kills(other->kind(), actor->kind()) && counter > guard;
+
+        if (actor_kills) {
+            kills.push_back({.killer = actor_id, .victim = editor_.idOf(h),
+                             .killer_kind = actor->kind(), .victim_kind = other->kind(),
+                             .x = other->x(), .y = other->y()});
+            editor_.kill(h);
+            ++stats_.kills;
+        }
+        if (other_kills) {
+            kills.push_back({.killer = editor_.idOf(h), .victim = actor_id,
+                             .killer_kind = other->kind(), .victim_kind = actor->kind(),
+                             .x = actor->x(), .y = actor->y()});
+            editor_.kill(ev.npc);
+            ++stats_.kills;
+            actor_dead = true;
+        }
+    }
+    editor_.compactIfSparse();
+
+    if (!actor_dead) add(ev.npc);
+    return true;
+}
+
+void DiscreteEventSim::runUntil(std::chrono::milliseconds until) {
+    std::vector<KillEvent> kills;
+    while (nextTime() < until) {
+        kills.clear();
+        step(kills);
+        if (kills.empty()) continue;
+        editor_.resolveNames(kills);
+        editor_.dispatch(kills);
+    }
+}
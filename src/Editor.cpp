@@ -1,9 +1,17 @@
 #include "Editor.h"
+#include "Trace.h"
 #include "NPCFactory.h"
-#include "FightRules.h"
+#include "KillMatrix.h"
+#include "SaveFile.h"
 #include <fstream>
 #include <algorithm>
+#include <array>
 #include <cmath>
+#include <exception>
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
 
 void Editor::addObserver(ObsPtr obs) {
     observers_.push_back(obs);
@@ -15,40 +23,168 @@ void Editor::removeObserver(ObsPtr obs) {
 bool Editor::addNPC(NPCPtr npc) {
     if (!npc) return false;
 
-    if (npc->x() < 0 || npc->x() > 500 || npc->y() < 0 || npc->y() > 500)
+    if (!inBounds(npc->x(), npc->y()))
         return false;
 
-    for (auto &e : npcs_) {
-        if (e->name() == npc->name())
-            return false;
-    }
+    NPCId id = names_.intern(npc->name());
+    if (id < handle_of_.size() && npcs_.contains(handle_of_[id]))
+        return false;
 
-    npcs_.push_back(npc);
+    insert(std::move(npc), id);
     return true;
 }
 
-void Editor::saveToFile(const std::string &filename) const {
-    std::ofstream out(filename);
-    for (auto &n : npcs_)
-        n->serialize(out);
+void Editor::insert(NPCPtr npc, NPCId id) {
+    if (id >= handle_of_.size())
+        handle_of_.resize(id + 1);
+    const NPC &n = *npc;
+    NPCHandle h = npcs_.insert(std::move(npc));
+    if (h.index >= ids_.size())
+        ids_.resize(h.index + 1, INVALID_NPC_ID);
+    ids_[h.index] = id;
+    handle_of_[id] = h;
+    stats_.onSpawn(n.kind(), n.x(), n.y());
+    grid_.insert(h, n.x(), n.y());
 }
 
-void Editor::loadFromFile(const std::string &filename) {
-    std::ifstream in(filename);
-    npcs_.clear();
+NPCHandle Editor::handleOf(NPCId id) const {
+    return id < handle_of_.size() ? handle_of_[id] : NPCHandle{};
+}
+
+NPCPtr Editor::find(NPCHandle h) const {
+    auto p = npcs_.get(h);
+    return p ? *p : nullptr;
+}
+
+bool Editor::moveNPC(NPCHandle h, double x, double y) {
+    auto p = npcs_.get(h);
+    if (!p || !inBounds(x, y)) return false;
 
-    while (true) {
-        auto npc = NPCFactory::loadFromStream(in);
-        if (!npc) break;
+    stats_.onMove((*p)->kind(), (*p)->x(), (*p)->y(), x, y);
+    *p = (*p)->cloneWithPosition(x, y);
+    grid_.move(h, x, y);
+    return true;
+}
+
+bool Editor::kill(NPCHandle h) {
+    auto p = npcs_.get(h);
+    if (!p) return false;
+
+    stats_.onKill((*p)->kind(), (*p)->x(), (*p)->y());
+    grid_.erase(h);
+    return npcs_.erase(h);
+}
+
+void Editor::enableRegionStats(int cols, int rows, double width, double height) {
+    stats_.enableRegions(cols, rows, width, height);
+    for (auto &n : npcs())
+        if (n) stats_.onSpawn(n->kind(), n->x(), n->y());
+}
 
-        if (!addNPC(npc))
-            throw std::runtime_error("Invalid or duplicate NPC in file");
+void Editor::saveToFile(const std::string &filename, unsigned threads) const {
+    writeNPCFile(npcs(), filename, threads);
+}
+
+void Editor::loadFromFile(const std::string &filename, unsigned threads) {
+    static constexpr size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+    clear();
+
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(filename, ec)) return;
+
+    MappedFile file(filename);
+    std::string_view text = file.view();
+    if (threads == 0) {
+        size_t by_size = text.size() / MIN_CHUNK_BYTES + 1;
+        threads = static_cast<unsigned>(std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), by_size));
+    }
+    auto pieces = splitRecords(text, threads);
+    const size_t parts = pieces.size();
+    if (parts == 0) return;
+
+    struct Chunk {
+        std::vector<NPCRecord> records;
+        std::vector<NPCPtr> npcs;
+        // Record indices grouped by name hash, one group per checker thread.
+        std::vector<std::vector<uint32_t>> by_part;
+        // Parse error at records.size(), if any.
+        std::exception_ptr error;
+        size_t first_out_of_bounds = SIZE_MAX;
+    };
+    std::vector<Chunk> chunks(parts);
+
+    parallelFor(parts, [&](size_t c) {
+        Chunk &chunk = chunks[c];
+        try {
+            parseNPCRecords(pieces[c], chunk.records);
+        } catch (...) {
+            chunk.error = std::current_exception();
+        }
+
+        std::hash<std::string_view> hash;
+        chunk.by_part.resize(parts);
+        chunk.npcs.reserve(chunk.records.size());
+        for (uint32_t i = 0; i < chunk.records.size(); ++i) {
+            const NPCRecord &r = chunk.records[i];
+            if (!inBounds(r.x, r.y) && chunk.first_out_of_bounds == SIZE_MAX) chunk.first_out_of_bounds = i;
+            chunk.by_part[hash(r.name) % parts].push_back(i);
+            chunk.npcs.push_back(NPCFactory::create(r.type, std::string(r.name), r.x, r.y));
+        }
+    });
+
+    // Each checker walks its names in file order, so the first repeat it
+    // meets is its earliest second occurrence: (chunk, record).
+    using Position = std::pair<size_t, size_t>;
+    constexpr Position NONE{SIZE_MAX, SIZE_MAX};
+    std::vector<Position> duplicate(parts, NONE);
+    parallelFor(parts, [&](size_t p) {
+        std::unordered_set<std::string_view> seen;
+        for (size_t c = 0; c < parts; ++c) {
+            for (uint32_t i : chunks[c].by_part[p]) {
+                if (!seen.insert(chunks[c].records[i].name).second) {
+                    duplicate[p] = {c, i};
+                    return;
+                }
+            }
+        }
+    });
+
+    // Report whichever problem the serial loader would have hit first.
+    Position invalid = *std::min_element(duplicate.begin(), duplicate.end());
+    for (size_t c = 0; c < parts; ++c) {
+        if (chunks[c].first_out_of_bounds != SIZE_MAX)
+            invalid = std::min(invalid, Position{c, chunks[c].first_out_of_bounds});
+        if (chunks[c].error) {
+            if (Position{c, chunks[c].records.size()} < invalid) std::rethrow_exception(chunks[c].error);
+            break;
+        }
+    }
+    if (invalid != NONE)
+        throw std::runtime_error("Invalid or duplicate NPC in file");
+
+    // Bounds and uniqueness are settled; only the ids remain to be interned.
+    size_t total = 0;
+    for (auto &chunk : chunks) total += chunk.npcs.size();
+    ids_.reserve(total);
+    for (auto &chunk : chunks) {
+        for (auto &npc : chunk.npcs) {
+            NPCId id = names_.intern(npc->name());
+            insert(std::move(npc), id);
+        }
     }
 }
 
+void Editor::clear() {
+    npcs_.clear();
+    stats_.clear();
+    grid_.clear();
+}
+
 void Editor::printAll(std::ostream &os) const {
     os << "NPC list (" << npcs_.size() << "):\n";
-    for (auto &n : npcs_) {
+    for (auto &n : npcs()) {
+        if (!n) continue;
         os << n->type() << " " << n->name()
            << " " << n->x() << " " << n->y() << "\n";
     }
@@ -60,46 +196,96 @@ static double dist2(const NPCPtr &a, const NPCPtr &b) {
     return dx*dx + dy*dy;
 }
 
+void Editor::resolveNames(std::span<KillEvent> events) const {
+    for (auto &e : events) {
+        e.killer_name = names_.name(e.killer);
+        e.victim_name = names_.name(e.victim);
+    }
+}
+
+void Editor::dispatch(std::span<const KillEvent> events) const {
+    if (events.empty()) return;
+    for (auto &o : observers_) o->onKills(events);
+}
+
+// Kills are simultaneous and nobody moves, so a single pass reaches the
+// fixed point: an in-range pair that survives it cannot interact, because
+// whichever side could kill would already have killed the other. No
+// confirming rescan is needed.
 void Editor::runBattle(double distance) {
-    FightRules rules;
+    TRACE_SCOPE("editor.battle");
+    const KillMatrix &matrix = KillMatrix::standard();
     double d2 = distance * distance;
 
-    bool killed = true;
+    compact();
+    // Terminal: no two living species can hurt each other.
+    if (!matrix.canKill(stats_.counts())) return;
 
-    while (killed) {
-        killed = false;
-        std::vector<std::string> dead;
+    const auto &npcs = npcs_.values();
+    const auto &handles = npcs_.handles();
 
-        for (size_t i = 0; i < npcs_.size(); ++i) {
-            for (size_t j = i+1; j < npcs_.size(); ++j) {
-                auto &A = npcs_[i];
-                auto &B = npcs_[j];
+    // Dense positions of each species, ascending, and their bounds.
+    std::array<std::vector<uint32_t>, NPC_TYPE_COUNT> species;
+    std::array<SpeciesBounds, NPC_TYPE_COUNT> bounds;
+    for (uint32_t i = 0; i < npcs.size(); ++i) {
+        size_t t = static_cast<size_t>(npcs[i]->kind());
+        species[t].push_back(i);
+        bounds[t].add(npcs[i]->x(), npcs[i]->y());
+    }
 
-                if (dist2(A,B) > d2) continue;
+    // A kill found while scanning; `order` restores the i<j pair order the
+    // full scan used to report in, whatever order the species pairs run in.
+    struct Kill {
+        uint64_t order;
+        uint32_t killer, victim;
+    };
+    std::vector<Kill> kills;
 
-                bool A_kills_B = A->accept(rules, *B);
-                bool B_kills_A = B->accept(rules, *A);
+    // Only species pairs where one side can kill the other are scanned, and
+    // only if their bounds come within reach (otherwise they are quiescent).
+    for (auto [a, b] : matrix.interactingPairs()) {
+        const auto &A = species[static_cast<size_t>(a)];
+        const auto &B = species[static_cast<size_t>(b)];
+        if (A.empty() || B.empty()) continue;
+        if (bounds[static_cast<size_t>(a)].gap2(bounds[static_cast<size_t>(b)]) > d2) continue;
 
-                if (A_kills_B) {
-                    dead.push_back(B->name());
-                    for (auto &o : observers_) o->onKill(A->name(), B->name());
-                }
-                if (B_kills_A) {
-                    dead.push_back(A->name());
-                    for (auto &o : observers_) o->onKill(B->name(), A->name());
-                }
-            }
-        }
+        const bool a_kills_b = matrix.kills(a, b);
+        const bool b_kills_a = matrix.kills(b, a);
 
-        if (!dead.empty()) {
-            killed = true;
+        auto fight = [&](uint32_t i, uint32_t j, bool i_kills_j, bool j_kills_i) {
+            if (dist2(npcs[i], npcs[j]) > d2) return;
+            uint64_t pair = i < j ? (uint64_t{i} << 32 | j) : (uint64_t{j} << 32 | i);
+            if (i_kills_j) kills.push_back({pair << 1 | (i > j), i, j});
+            if (j_kills_i) kills.push_back({pair << 1 | (j > i), j, i});
+        };
 
-            std::sort(dead.begin(), dead.end());
-            dead.erase(std::unique(dead.begin(), dead.end()), dead.end());
-
-            npcs_.erase(std::remove_if(npcs_.begin(), npcs_.end(),
-                [&](auto &p){ return std::binary_search(dead.begin(), dead.end(), p->name()); }),
-                npcs_.end());
+        if (a == b) {
+            for (size_t x = 0; x < A.size(); ++x)
+                for (size_t y = x + 1; y < A.size(); ++y)
+                    fight(A[x], A[y], a_kills_b, a_kills_b);
+        } else {
+            for (uint32_t i : A)
+                for (uint32_t j : B)
+                    fight(i, j, a_kills_b, b_kills_a);
         }
     }
-}
\ No newline at end of file
+    if (kills.empty()) return;
+
+    std::sort(kills.begin(), kills.end(), [](const Kill &l, const Kill &r) { return l.order < r.order; });
+    std::vector<KillEvent> events;
+    events.reserve(kills.size());
+    for (const Kill &k : kills) {
+        const auto &killer = npcs[k.killer];
+        const auto &victim = npcs[k.victim];
+        events.push_back({.killer = idOf(handles[k.killer]), .victim = idOf(handles[k.victim]),
+                          .killer_kind = killer->kind(), .victim_kind = victim->kind(),
+                          .x = victim->x(), .y = victim->y()});
+    }
+
+    resolveNames(events);
+    dispatch(events);
+
+    for (const Kill &k : kills)
+        kill(handles[k.victim]);
+    compact();
+}
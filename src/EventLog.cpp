@@ -0,0 +1,187 @@
+#include "EventLog.h"
+#include "Varint.h"
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iterator>
+#include <stdexcept>
+
+static constexpr char EVENT_LOG_MAGIC[4] = {'L', '7', 'E', 'V'};
+static constexpr char EVENT_LOG_VERSION = 1;
+
+enum : char { TAG_NAME = 1, TAG_KILL = 2 };
+
+static std::int64_t quantize(double v) {
+    return static_cast<std::int64_t>(std::llround(v * 100.0));
+}
+
+std::string eventLogSegmentPath(const std::string &base, std::uint64_t segment) {
+    char num[24];
+    std::snprintf(num, sizeof(num), "%06llu", static_cast<unsigned long long>(segment));
+    return base + "." + num + ".bin";
+}
+
+EventLogWriter::EventLogWriter(std::string base, EventLogOptions opts)
+    : base_(std::move(base)), opts_(opts) {
+    while (std::filesystem::exists(eventLogSegmentPath(base_, segment_)))
+        ++segment_;
+    buf_.reserve(opts_.buffer_bytes);
+    openSegment();
+}
+
+EventLogWriter::~EventLogWriter() {
+    flush();
+}
+
+void EventLogWriter::openSegment() {
+    out_.open(currentPath(), std::ios::binary | std::ios::trunc);
+    if (!out_) throw std::runtime_error("Cannot open event log: " + currentPath());
+
+    opened_at_ = std::chrono::steady_clock::now();
+    segment_bytes_ = 0;
+    defined_.clear();
+    last_tick_ = 0;
+    last_killer_ = last_victim_ = 0;
+    last_x_ = last_y_ = 0;
+
+    buf_.append(EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC));
+    buf_.push_back(EVENT_LOG_VERSION);
+}
+
+void EventLogWriter::writeBuffer() {
+    if (buf_.empty()) return;
+    out_.write(buf_.data(), static_cast<std::streamsize>(buf_.size()));
+    segment_bytes_ += buf_.size();
+    buf_.clear();
+}
+
+void EventLogWriter::flush() {
+    writeBuffer();
+    out_.flush();
+}
+
+void EventLogWriter::rotate() {
+    flush();
+    out_.close();
+    ++segment_;
+    openSegment();
+}
+
+void EventLogWriter::defineName(NPCId id, std::string_view name) {
+    if (id < defined_.size() && defined_[id]) return;
+    if (id >= defined_.size()) defined_.resize(id + 1, 0);
+    defined_[id] = 1;
+
+    buf_.push_back(TAG_NAME);
+    putVarint(buf_, id);
+    putVarint(buf_, name.size());
+    buf_.append(name);
+}
+
+void EventLogWriter::append(const KillRecord &r, std::string_view killer_name, std::string_view victim_name) {
+    if (segment_bytes_ + buf_.size() >= opts_.max_bytes ||
+        std::chrono::steady_clock::now() - opened_at_ >= opts_.max_age)
+        rotate();
+
+    defineName(r.killer, killer_name);
+    defineName(r.victim, victim_name);
+
+    std::int64_t qx = quantize(r.x);
+    std::int64_t qy = quantize(r.y);
+
+    buf_.push_back(TAG_KILL);
+    putVarint(buf_, zigzag(static_cast<std::int64_t>(r.tick - last_tick_)));
+    putVarint(buf_, zigzag(static_cast<std::int64_t>(r.killer) - last_killer_));
+    putVarint(buf_, zigzag(static_cast<std::int64_t>(r.victim) - last_victim_));
+    buf_.push_back(static_cast<char>((static_cast<int>(r.killer_kind) << 4) | static_cast<int>(r.victim_kind)));
+    putVarint(buf_, zigzag(qx - last_x_));
+    putVarint(buf_, zigzag(qy - last_y_));
+
+    last_tick_ = r.tick;
+    last_killer_ = r.killer;
+    last_victim_ = r.victim;
+    last_x_ = qx;
+    last_y_ = qy;
+
+    if (buf_.size() >= opts_.buffer_bytes) writeBuffer();
+}
+
+EventLogReader::EventLogReader(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Cannot open event log: " + path);
+    data_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+    if (data_.size() < sizeof(EVENT_LOG_MAGIC) + 1 ||
+        data_.compare(0, sizeof(EVENT_LOG_MAGIC), EVENT_LOG_MAGIC, sizeof(EVENT_LOG_MAGIC)) != 0 ||
+        data_[sizeof(EVENT_LOG_MAGIC)] != EVENT_LOG_VERSION)
+        throw std::runtime_error("Not an event log: " + path);
+
+    pos_ = data_.data() + sizeof(EVENT_LOG_MAGIC) + 1;
+    end_ = data_.data() + data_.size();
+}
+
+bool EventLogReader::next(KillRecord &r) {
+    while (pos_ < end_) {
+        const char *p = pos_;
+        char tag = *p++;
+
+        if (tag == TAG_NAME) {
+            std::uint64_t id, len;
+            if (!getVarint(p, end_, id) || !getVarint(p, end_, len) ||
+                len > static_cast<std::uint64_t>(end_ - p))
+                return false;
+            if (id >= names_.size()) names_.resize(id + 1);
+            names_[id].assign(p, len);
+            pos_ = p + len;
+            continue;
+        }
+        if (tag != TAG_KILL) return false;
+
+        std::uint64_t tick, killer, victim, x, y;
+        if (!getVarint(p, end_, tick) || !getVarint(p, end_, killer) ||
+            !getVarint(p, end_, victim) || p >= end_)
+            return false;
+        auto kinds = static_cast<unsigned char>(*p++);
+        if (!getVarint(p, end_, x) || !getVarint(p, end_, y))
+            return false;
+
+        last_tick_ += static_cast<std::uint64_t>(unzigzag(tick));
+        last_killer_ += unzigzag(killer);
+        last_victim_ += unzigzag(victim);
+        last_x_ += unzigzag(x);
+        last_y_ += unzigzag(y);
+
+        r.tick = last_tick_;
+        r.killer = static_cast<NPCId>(last_killer_);
+        r.victim = static_cast<NPCId>(last_victim_);
+        r.killer_kind = static_cast<NPCType>(kinds >> 4);
+        r.victim_kind = static_cast<NPCType>(kinds & 0x0f);
+        r.x = static_cast<double>(last_x_) / 100.0;
+        r.y = static_cast<double>(last_y_) / 100.0;
+        pos_ = p;
+        return true;
+    }
+    return false;
+}
+
+std::string_view EventLogReader::name(NPCId id) const {
+    return id < names_.size() ? std::string_view(names_[id]) : std::string_view("?");
+}
+
+BinaryLogObserver::BinaryLogObserver(const std::string &base, EventLogOptions opts)
+    : writer_(base, opts) {}
+
+void BinaryLogObserver::onKill(const std::string &, const std::string &) {
+    throw std::logic_error("BinaryLogObserver records KillEvent batches only");
+}
+
+void BinaryLogObserver::onKills(std::span<const KillEvent> events) {
+    ++round_;
+    for (auto &e : events) {
+        NPCId killer = names_.intern(e.killer_name);
+        NPCId victim = names_.intern(e.victim_name);
+        writer_.append({round_, killer, victim, e.killer_kind, e.victim_kind, e.x, e.y},
+                       e.killer_name, e.victim_name);
+    }
+    writer_.flush();
+}
@@ -1,23 +1,45 @@
 #include "Game.h"
 #include "Observer.h"
-#include "FightRules.h"
+#include "KillMatrix.h"
+#include "SaveFile.h"
+#include "Placement.h"
+#include "Trace.h"
+#include "DiscreteEventSim.h"
 #include <iostream>
 #include <chrono>
 #include <cmath>
 #include <algorithm>
+#include <array>
 #include <sstream>
 #include <iomanip>
 #include <fstream>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
 
 using namespace std::chrono_literals;
 
-Game::Game() 
-    : gen_(rd_()), 
+Game::Game(GameConfig config) 
+    : verbose_(config.verbose),
+      discrete_events_(config.discrete_events),
+      lockstep_(config.lockstep),
+      scheduler_(config.scheduler ? config.scheduler : std::make_shared<Scheduler>(config.threads, config.cpus)),
+      pause_gate_(*scheduler_),
+      battle_budget_(config.battle_budget),
+      event_log_base_(config.event_log),
+      event_log_options_(config.event_log_options),
+      trace_path_(config.trace),
+      gen_(rd_()), 
       pos_dist_(0.0, MAP_WIDTH),
       type_dist_(0, 2) { 
     
-    editor_.addObserver(std::make_shared<ConsoleObserver>());
-    editor_.addObserver(std::make_shared<FileObserver>("game_log.txt"));
+    if (discrete_events_ && lockstep_)
+        throw std::invalid_argument("A game cannot run both discrete events and lockstep ticks");
+    
+    editor_.enableRegionStats(MAP_GRID, MAP_GRID, MAP_WIDTH, MAP_HEIGHT);
+    snapshot_.store(snapshots_.current());
+    if (!config.trajectory.empty())
+        trajectory_ = std::make_unique<TrajectoryRecorder>(config.trajectory, config.trajectory_options);
 }
 
 Game::~Game() {
@@ -27,9 +49,9 @@ Game::~Game() {
 void Game::generateInitialNPCs() {
     std::unique_lock<std::shared_mutex> lock(npc_mutex_);
     
-    std::vector<std::string> bear_names = {"Ursa", "Grizzly", "Brown", "Black", "Polar", "Honey", "Teddy", "Growler", "Fuzzy", "Bruno"};
-    std::vector<std::string> bittern_names = {"Wader", "Heron", "Egret", "Stork", "Crane", "Ibis", "Spoonbill", "Flamingo", "Pelican", "Grebe"};
-    std::vector<std::string> desman_names = {"Mole", "Shrew", "Vole", "Muskrat", "Beaver", "Otter", "Mink", "Weasel", "Ferret", "Badger"};
+    static const std::vector<std::string> bear_names = {"Ursa", "Grizzly", "Brown", "Black", "Polar", "Honey", "Teddy", "Growler", "Fuzzy", "Bruno"};
+    static const std::vector<std::string> bittern_names = {"Wader", "Heron", "Egret", "Stork", "Crane", "Ibis", "Spoonbill", "Flamingo", "Pelican", "Grebe"};
+    static const std::vector<std::string> desman_names = {"Mole", "Shrew", "Vole", "Muskrat", "Beaver", "Otter", "Mink", "Weasel", "Ferret", "Badger"};
     
     int count = 0;
     while (count < 50) {
@@ -56,21 +78,104 @@ void Game::generateInitialNPCs() {
         }
     }
     
-    alive_count_ = 50;
+    initial_count_ = 50;
+    if (changes_) changes_->reset();
+    snapshots_.reset(editor_);
+    publishSnapshot();
     
-    {
+    if (verbose_) {
+        const auto& stats = editor_.stats();
         std::lock_guard<std::mutex> cout_lock(cout_mutex_);
         std::cout << "[GAME] Generated 50 NPCs:" << std::endl;
-        
-        int bears = 0, bitterns = 0, desmans = 0;
-        for (const auto& npc : editor_.npcs()) {
-            if (npc->type() == "Bear") bears++;
-            else if (npc->type() == "Bittern") bitterns++;
-            else if (npc->type() == "Desman") desmans++;
+        std::cout << "[GAME] Bears: " << stats.count(NPCType::Bear)
+                  << ", Bitterns: " << stats.count(NPCType::Bittern)
+                  << ", Desmans: " << stats.count(NPCType::Desman) << std::endl;
+    }
+}
+
+void Game::publishSnapshot() {
+    TRACE_SCOPE("snapshot.publish");
+    std::shared_ptr<WorldSnapshot> next = snapshots_.build();
+    // Committed before the version becomes visible to the query server.
+    if (changes_) changes_->commit(next->version);
+    snapshot_.store(std::move(next));
+    if (query_server_) query_server_->notify();
+}
+
+void Game::publishViews() {
+    if (!world_view_ && !trajectory_) return;
+    // The logging task and step() may publish at the same time.
+    std::lock_guard<std::mutex> lock(view_mutex_);
+    SnapshotPtr snap = snapshot_.load();
+    if (snap->version == viewed_version_) return;
+    viewed_version_ = snap->version;
+    
+    if (world_view_) {
+        TRACE_SCOPE("world_view.publish");
+        world_view_->publish(*snap);
+    }
+    if (trajectory_) trajectory_->record(std::move(snap));
+}
+
+void Game::addObserver(ObsPtr obs) {
+    if (running_) throw std::logic_error("Cannot add observers to a running game");
+    
+    std::unique_lock<std::shared_mutex> lock(npc_mutex_);
+    editor_.addObserver(obs);
+}
+
+void Game::enableWorldView(const std::string &name, std::uint32_t capacity) {
+    if (running_) throw std::logic_error("Cannot enable world view on a running game");
+    
+    std::unique_lock<std::shared_mutex> lock(npc_mutex_);
+    world_view_ = std::make_unique<WorldViewPublisher>(name, capacity);
+    world_view_->publish(*snapshot_.load());
+}
+
+void Game::enableQueryServer(const std::string &path, QueryServerOptions opts) {
+    if (running_) throw std::logic_error("Cannot enable the query server on a running game");
+    
+    std::unique_lock<std::shared_mutex> lock(npc_mutex_);
+    changes_ = std::make_unique<ChangeLog>();
+    query_server_ = std::make_unique<QueryServer>(path, snapshot_, editor_.stats(), changes_.get(), opts);
+}
+
+std::future<void> Game::checkpoint(const std::string &path) {
+    SnapshotPtr snap = snapshot_.load();
+    
+    std::promise<void> done;
+    auto result = done.get_future();
+    
+    std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+    if (checkpoint_thread_.joinable()) checkpoint_thread_.join();
+    checkpoint_thread_ = std::thread([snap, path, done = std::move(done)]() mutable {
+        try {
+            writeNPCFile(snap->npcs, path);
+            done.set_value();
+        } catch (...) {
+            done.set_exception(std::current_exception());
         }
+    });
+    return result;
+}
+
+void Game::resume(const std::string &path) {
+    if (running_) throw std::logic_error("Cannot resume a running game");
+    if (!std::filesystem::exists(path))
+        throw std::runtime_error("Checkpoint not found: " + path);
+    
+    auto load = [&] {
+        std::unique_lock<std::shared_mutex> lock(npc_mutex_);
+        editor_.loadFromFile(path);
         
-        std::cout << "[GAME] Bears: " << bears << ", Bitterns: " << bitterns << ", Desmans: " << desmans << std::endl;
-    }
+        initial_count_ = editor_.stats().total();
+        resumed_ = true;
+        if (changes_) changes_->reset();
+        snapshots_.reset(editor_);
+        publishSnapshot();
+    };
+    if (scheduler_->pinned()) scheduler_->runOnWorker(load);
+    else load();
 }
 
 double Game::calculateDistance(double x1, double y1, double x2, double y2) const {
@@ -79,260 +184,354 @@ double Game::calculateDistance(double x1, double y1, double x2, double y2) const
     return std::sqrt(dx*dx + dy*dy);
 }
 
-void Game::movementWorker() {
-    std::uniform_int_distribution<> sleep_dist(50, 200);
+void Game::moveStep() {
+    TRACE_SCOPE("move");
     std::uniform_real_distribution<> move_dist(-MOVE_DISTANCE, MOVE_DISTANCE);
     
-    while (running_) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(sleep_dist(gen_)));
-        
-        std::shared_lock<std::shared_mutex> read_lock(npc_mutex_);
-        auto npcs = editor_.npcs();
+    SnapshotPtr snap = snapshot_.load();
+    const auto& npcs = snap->npcs;
+    
+    if (npcs.empty()) return;
+    
+    std::uniform_int_distribution<> idx_dist(0, static_cast<int>(npcs.size()) - 1);
+    int idx = idx_dist(move_gen_);
+    const auto& npc_to_move = npcs[idx];
+    
+    double new_x = npc_to_move->x() + move_dist(move_gen_);
+    double new_y = npc_to_move->y() + move_dist(move_gen_);
+    
+    new_x = std::clamp(new_x, 0.0, MAP_WIDTH);
+    new_y = std::clamp(new_y, 0.0, MAP_HEIGHT);
+    
+    std::unique_lock<std::shared_mutex> write_lock(npc_mutex_, std::defer_lock);
+    {
+        TRACE_SCOPE("move.wait_lock");
+        write_lock.lock();
+    }
+    if (editor_.moveNPC(snap->handles[idx], new_x, new_y)) {
+        if (changes_) changes_->moved(snap->ids[idx]);
+        snapshots_.moved(snap->handles[idx], editor_.find(snap->handles[idx]));
+        publishSnapshot();
+    }
+}
+
+void Game::resetBattlePass() {
+    battle_pass_.snap.reset();
+}
+
+void Game::recordSlice(std::chrono::steady_clock::duration took, size_t checked, bool pass_done) {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(took);
+    std::lock_guard<std::mutex> lock(slice_mutex_);
+    ++slice_stats_.slices;
+    if (pass_done) ++slice_stats_.passes;
+    slice_stats_.pairs += checked;
+    slice_stats_.last = ns;
+    slice_stats_.max = std::max(slice_stats_.max, ns);
+    slice_stats_.total += ns;
+}
+
+BattleSliceStats Game::battleSlices() const {
+    std::lock_guard<std::mutex> lock(slice_mutex_);
+    return slice_stats_;
+}
+
+void Game::battleStep() {
+    TRACE_SCOPE("battle");
+    const auto slice_start = std::chrono::steady_clock::now();
+    std::uniform_int_distribution<> dice_dist(1, 6);
+    const KillMatrix &matrix = KillMatrix::standard();
+    BattlePass &pass = battle_pass_;
+    
+    if (!pass.snap) {
+        SnapshotPtr snap = snapshot_.load();
+        if (snap->npcs.size() < 2) return;
         
-        if (npcs.empty()) {
-            read_lock.unlock();
-            continue;
-        }
+        for (auto& list : pass.species) list.clear();
+        pass.bounds = {};
+        pass.killed.clear();
+        pass.indexed = pass.pair = pass.x = pass.y = 0;
+        pass.snap = std::move(snap);
+    }
+    
+    const auto& npcs = pass.snap->npcs;
+    const auto& ids = pass.snap->ids;
+    const auto& handles = pass.snap->handles;
+    auto& killed = pass.killed;
+    
+    std::vector<NPCHandle> killed_npcs;
+    std::vector<KillEvent> kill_events;
+    
+    auto fight = [&](size_t i, size_t j, bool i_kills_j, bool j_kills_i) {
+        if (killed[i] || killed[j]) return;
         
-        std::uniform_int_distribution<> idx_dist(0, static_cast<int>(npcs.size()) - 1);
-        int idx = idx_dist(gen_);
-        auto npc_to_move = npcs[idx];
-        read_lock.unlock();
+        double dist = calculateDistance(
+            npcs[i]->x(), npcs[i]->y(),
+            npcs[j]->x(), npcs[j]->y()
+        );
+        if (dist > KILL_DISTANCE) return;
         
-        double new_x = npc_to_move->x() + move_dist(gen_);
-        double new_y = npc_to_move->y() + move_dist(gen_);
+        int attack_power_i = dice_dist(battle_gen_);
+        int defense_power_j = dice_dist(battle_gen_);
         
-        new_x = std::clamp(new_x, 0.0, MAP_WIDTH);
-        new_y = std::clamp(new_y, 0.0, MAP_HEIGHT);
+        int attack_power_j = dice_dist(battle_gen_);
+        int defense_power_i = dice_dist(battle_gen_);
         
-        auto new_npc = npc_to_move->cloneWithPosition(new_x, new_y);
+        bool i_can_kill_j = i_kills_j && attack_power_i > defense_power_j;
+        bool j_can_kill_i = j_kills_i && attack_power_j > defense_power_i;
         
-        std::unique_lock<std::shared_mutex> write_lock(npc_mutex_);
-        auto& all_npcs = const_cast<std::vector<NPCPtr>&>(editor_.npcs());
-        for (auto& existing_npc : all_npcs) {
-            if (existing_npc->name() == npc_to_move->name()) {
-                existing_npc = new_npc;
-                break;
+        if (i_can_kill_j) {
+            killed[j] = 1;
+            killed_npcs.push_back(handles[j]);
+            kill_events.push_back({.killer = ids[i], .victim = ids[j],
+                                   .killer_kind = npcs[i]->kind(), .victim_kind = npcs[j]->kind(),
+                                   .x = npcs[j]->x(), .y = npcs[j]->y()});
+        }
+        if (j_can_kill_i) {
+            killed[i] = 1;
+            killed_npcs.push_back(handles[i]);
+            kill_events.push_back({.killer = ids[j], .victim = ids[i],
+                                   .killer_kind = npcs[j]->kind(), .victim_kind = npcs[i]->kind(),
+                                   .x = npcs[i]->x(), .y = npcs[i]->y()});
+        }
+    };
+    
+    // The pass first sorts the snapshot into species, one NPC per unit of
+    // budget, so no slice pays for the whole population. Pairs of species
+    // that cannot hurt each other are never looked at, nor are species whose
+    // bounds are out of kill range of each other. The cursor stops before
+    // the first unit over budget and the next step resumes there.
+    const auto& pairs = matrix.interactingPairs();
+    const size_t budget = battle_budget_ ? battle_budget_ : SIZE_MAX;
+    size_t used = 0, checked = 0;
+    auto scan = [&] {
+        for (; pass.indexed < npcs.size(); ++pass.indexed) {
+            if (used == budget) return false;
+            ++used;
+            size_t t = static_cast<size_t>(npcs[pass.indexed]->kind());
+            pass.species[t].push_back(pass.indexed);
+            pass.bounds[t].add(npcs[pass.indexed]->x(), npcs[pass.indexed]->y());
+            killed.push_back(0);
+        }
+        for (; pass.pair < pairs.size(); ++pass.pair, pass.x = 0, pass.y = 0) {
+            auto [a, b] = pairs[pass.pair];
+            const auto& A = pass.species[static_cast<size_t>(a)];
+            const auto& B = pass.species[static_cast<size_t>(b)];
+            if (A.empty() || B.empty()) continue;
+            if (pass.bounds[static_cast<size_t>(a)].gap2(pass.bounds[static_cast<size_t>(b)]) > KILL_DISTANCE * KILL_DISTANCE)
+                continue;
+            
+            const bool a_kills_b = matrix.kills(a, b);
+            const bool b_kills_a = matrix.kills(b, a);
+            
+            for (; pass.x < A.size(); ++pass.x, pass.y = 0) {
+                // Within one species each unordered pair is checked once.
+                if (a == b && pass.y <= pass.x) pass.y = pass.x + 1;
+                for (; pass.y < B.size(); ++pass.y) {
+                    if (used == budget) return false;
+                    ++used;
+                    ++checked;
+                    fight(A[pass.x], B[pass.y], a_kills_b, b_kills_a);
+                }
             }
         }
+        return true;
+    };
+    const bool pass_done = scan();
+    
+    // Recorded on every way out, including slices without kills.
+    struct SliceTimer {
+        Game &game;
+        std::chrono::steady_clock::time_point start;
+        size_t checked;
+        bool pass_done;
+        ~SliceTimer() { game.recordSlice(std::chrono::steady_clock::now() - start, checked, pass_done); }
+    } timer{*this, slice_start, checked, pass_done};
+    // A finished pass lets go of its snapshot when this step returns; the
+    // next step starts over from the latest one.
+    SnapshotPtr finished;
+    if (pass_done) finished = std::move(pass.snap);
+    
+    if (killed_npcs.empty()) return;
+    
+    std::unique_lock<std::shared_mutex> write_lock(npc_mutex_, std::defer_lock);
+    {
+        TRACE_SCOPE("battle.wait_lock");
+        write_lock.lock();
+    }
+    TRACE_SCOPE("battle.apply");
+    // killed_npcs[i] is the victim of kill_events[i]. A victim that died or
+    // was replaced since the pass's snapshot is not killed again, and its
+    // event is dropped so nobody reports a kill that did not happen.
+    size_t removed = 0;
+    for (size_t i = 0; i < killed_npcs.size(); ++i) {
+        NPCHandle h = killed_npcs[i];
+        NPCId id = editor_.idOf(h);
+        if (!editor_.kill(h)) continue;
+        snapshots_.removed(h);
+        if (changes_) changes_->removed(id);
+        kill_events[removed++] = kill_events[i];
     }
+    if (removed == 0) return;
+    kill_events.resize(removed);
+    editor_.compactIfSparse();
+    
+    KillRound round;
+    round.tick = ++battle_round_;
+    round.killer_types.reserve(kill_events.size());
+    for (const auto& kill : kill_events)
+        round.killer_types.push_back(npcTypeName(kill.killer_kind));
+    round.events = std::move(kill_events);
+    
+    publishSnapshot();
+    write_lock.unlock();
+    
+    std::lock_guard<std::mutex> log_lock(log_mutex_);
+    pending_rounds_.push_back(std::move(round));
 }
 
-void Game::battleWorker() {
-    std::uniform_int_distribution<> sleep_dist(100, 300);
-    std::uniform_int_distribution<> dice_dist(1, 6);
-    FightRules rules;
+void Game::flushLog() {
+    TRACE_SCOPE("log.flush");
+    // The logging task and step() may flush at the same time.
+    std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+    std::vector<KillRound> rounds;
+    {
+        std::lock_guard<std::mutex> log_lock(log_mutex_);
+        rounds.swap(pending_rounds_);
+    }
+    if (rounds.empty()) return;
     
-    while (running_) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(sleep_dist(gen_)));
-        
+    {
         std::shared_lock<std::shared_mutex> read_lock(npc_mutex_);
-        auto npcs = editor_.npcs();
-        read_lock.unlock();
-        
-        if (npcs.size() < 2) continue;
-        
-        std::vector<std::string> killed_npcs;
-        std::vector<std::pair<std::string, std::string>> kill_events;
-        
-        for (size_t i = 0; i < npcs.size(); ++i) {
-            for (size_t j = i + 1; j < npcs.size(); ++j) {
-                if (std::find(killed_npcs.begin(), killed_npcs.end(), npcs[i]->name()) != killed_npcs.end() ||
-                    std::find(killed_npcs.begin(), killed_npcs.end(), npcs[j]->name()) != killed_npcs.end()) {
-                    continue;
-                }
-                
-                double dist = calculateDistance(
-                    npcs[i]->x(), npcs[i]->y(),
-                    npcs[j]->x(), npcs[j]->y()
-                );
-                
-                if (dist <= KILL_DISTANCE) {
-                    int attack_power_i = dice_dist(gen_);
-                    int defense_power_j = dice_dist(gen_);
-                    
-                    int attack_power_j = dice_dist(gen_);
-                    int defense_power_i = dice_dist(gen_);
-                    
-                    bool i_can_kill_j = false;
-                    bool j_can_kill_i = false;
-                    
-                    if (attack_power_i > defense_power_j) {
-                        i_can_kill_j = npcs[i]->accept(rules, *npcs[j]);
-                    }
-                    
-                    if (attack_power_j > defense_power_i) {
-                        j_can_kill_i = npcs[j]->accept(rules, *npcs[i]);
-                    }
-                    
-                    if (i_can_kill_j && !j_can_kill_i) {
-                        killed_npcs.push_back(npcs[j]->name());
-                        kill_events.emplace_back(npcs[i]->name(), npcs[j]->name());
-                    } else if (j_can_kill_i && !i_can_kill_j) {
-                        killed_npcs.push_back(npcs[i]->name());
-                        kill_events.emplace_back(npcs[j]->name(), npcs[i]->name());
-                    } else if (i_can_kill_j && j_can_kill_i) {
-                        killed_npcs.push_back(npcs[i]->name());
-                        killed_npcs.push_back(npcs[j]->name());
-                        kill_events.emplace_back(npcs[i]->name(), npcs[j]->name());
-                        kill_events.emplace_back(npcs[j]->name(), npcs[i]->name());
-                    }
-                }
-            }
+        for (auto& round : rounds)
+            editor_.resolveNames(round.events);
+    }
+    
+    if (!event_log_ && !event_log_base_.empty()) {
+        try {
+            event_log_ = std::make_unique<EventLogWriter>(event_log_base_, event_log_options_);
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> cout_lock(cout_mutex_);
+            std::cout << "[GAME] Event log disabled: " << e.what() << std::endl;
+            event_log_base_.clear();
         }
+    }
+    
+    std::string console;
+    for (const auto& round : rounds) {
+        editor_.dispatch(round.events);
         
-        if (!killed_npcs.empty()) {
-            std::unique_lock<std::shared_mutex> write_lock(npc_mutex_);
-            
-            auto& all_npcs = const_cast<std::vector<NPCPtr>&>(editor_.npcs());
-            auto new_end = std::remove_if(all_npcs.begin(), all_npcs.end(),
-                [&](const NPCPtr& npc) {
-                    return std::find(killed_npcs.begin(), killed_npcs.end(), npc->name()) != killed_npcs.end();
-                });
+        for (size_t i = 0; i < round.events.size(); ++i) {
+            const auto& kill = round.events[i];
+            if (verbose_) {
+                console += "[BATTLE] ";
+                console += kill.killer_name;
+                console += " (";
+                console += round.killer_types[i];
+                console += ") killed ";
+                console += kill.victim_name;
+                console += '\n';
+            }
             
-            if (new_end != all_npcs.end()) {
-                all_npcs.erase(new_end, all_npcs.end());
-                
-                for (const auto& kill : kill_events) {
-                    std::string killer_type = "Unknown";
-                    for (const auto& npc : all_npcs) {
-                        if (npc->name() == kill.first) {
-                            killer_type = npc->type();
-                            break;
-                        }
-                    }
-                    
-                    std::lock_guard<std::mutex> cout_lock(cout_mutex_);
-                    std::cout << "[BATTLE] " << kill.first << " (" << killer_type 
-                              << ") killed " << kill.second << std::endl;
-                }
-                
-                alive_count_ = static_cast<int>(all_npcs.size());
-                
-                std::ofstream log_file("game_log.txt", std::ios::app);
-                if (log_file) {
-                    for (const auto& kill : kill_events) {
-                        log_file << "[BATTLE] " << kill.first << " killed " << kill.second << std::endl;
-                    }
-                }
+            if (event_log_) {
+                event_log_->append({round.tick, kill.killer, kill.victim, kill.killer_kind,
+                                    kill.victim_kind, kill.x, kill.y},
+                                   kill.killer_name, kill.victim_name);
             }
         }
     }
+    
+    if (!console.empty()) {
+        std::lock_guard<std::mutex> cout_lock(cout_mutex_);
+        std::cout.write(console.data(), static_cast<std::streamsize>(console.size()));
+        std::cout.flush();
+    }
+    
+    if (event_log_) event_log_->flush();
 }
 
-void Game::mainWorker() {
-    auto start_time = std::chrono::steady_clock::now();
-    auto duration = 30s;
-    
-    int map_updates = 0;
+void Game::renderMap(int map_updates, std::chrono::steady_clock::duration elapsed) {
+    static constexpr char symbols[NPC_TYPE_COUNT] = {'B', 'I', 'D'};
+    const auto& stats = editor_.stats();
+    TRACE_SCOPE("render");
     
-    while (running_) {
-        auto current_time = std::chrono::steady_clock::now();
-        auto elapsed = current_time - start_time;
-        
-        if (elapsed >= duration) {
-            running_ = false;
-            break;
+    {
+        std::unique_lock<std::mutex> cout_lock(cout_mutex_, std::defer_lock);
+        {
+            TRACE_SCOPE("render.wait_cout");
+            cout_lock.lock();
         }
         
-        std::this_thread::sleep_for(1s);
+        std::cout << "\n=== Game Map Update #" << map_updates 
+                  << " (Alive: " << stats.total() 
+                  << ", Time: " << std::chrono::duration_cast<std::chrono::seconds>(elapsed).count()
+                  << "s) ===" << std::endl;
         
-        std::shared_lock<std::shared_mutex> read_lock(npc_mutex_);
-        auto npcs = editor_.npcs();
-        read_lock.unlock();
+        std::cout << "Stats: B=" << stats.count(NPCType::Bear)
+                  << " I=" << stats.count(NPCType::Bittern)
+                  << " D=" << stats.count(NPCType::Desman) << std::endl;
         
-        {
-            std::lock_guard<std::mutex> cout_lock(cout_mutex_);
-            
-            map_updates++;
-            std::cout << "\n=== Game Map Update #" << map_updates 
-                      << " (Alive: " << alive_count_ 
-                      << ", Time: " << std::chrono::duration_cast<std::chrono::seconds>(elapsed).count()
-                      << "s) ===" << std::endl;
-            
-            const int grid_size = 10;
-            std::vector<std::vector<char>> grid(grid_size, std::vector<char>(grid_size, '.'));
-            std::vector<std::vector<int>> count_grid(grid_size, std::vector<int>(grid_size, 0));
-            
-            for (const auto& npc : npcs) {
-                int grid_x = static_cast<int>((npc->x() / MAP_WIDTH) * grid_size);
-                int grid_y = static_cast<int>((npc->y() / MAP_HEIGHT) * grid_size);
-                
-                grid_x = std::clamp(grid_x, 0, grid_size - 1);
-                grid_y = std::clamp(grid_y, 0, grid_size - 1);
-                
-                count_grid[grid_y][grid_x]++;
-                
-                char symbol = '?';
-                std::string type = npc->type();
-                if (type == "Bear") symbol = 'B';
-                else if (type == "Bittern") symbol = 'I';
-                else if (type == "Desman") symbol = 'D';
-                
-                if (grid[grid_y][grid_x] == '.') {
-                    grid[grid_y][grid_x] = symbol;
-                } 
-                else if (grid[grid_y][grid_x] != symbol && grid[grid_y][grid_x] != 'X') {
-                    grid[grid_y][grid_x] = 'X';
+        std::cout << "    ";
+        for (int x = 0; x < MAP_GRID; ++x) {
+            std::cout << std::setw(2) << x << " ";
+        }
+        std::cout << std::endl;
+        
+        for (int y = 0; y < MAP_GRID; ++y) {
+            std::cout << std::setw(2) << y << "  ";
+            for (int x = 0; x < MAP_GRID; ++x) {
+                int total = 0;
+                char symbol = '.';
+                for (size_t t = 0; t < NPC_TYPE_COUNT; ++t) {
+                    int n = stats.regionCount(x, y, static_cast<NPCType>(t));
+                    if (n <= 0) continue;
+                    total += n;
+                    symbol = symbol == '.' ? symbols[t] : 'X';
                 }
-            }
-            
-            int bears = 0, bitterns = 0, desmans = 0;
-            for (const auto& npc : npcs) {
-                std::string type = npc->type();
-                if (type == "Bear") bears++;
-                else if (type == "Bittern") bitterns++;
-                else if (type == "Desman") desmans++;
-            }
-            
-            std::cout << "Stats: B=" << bears << " I=" << bitterns << " D=" << desmans << std::endl;
-            
-            std::cout << "    ";
-            for (int x = 0; x < grid_size; ++x) {
-                std::cout << std::setw(2) << x << " ";
-            }
-            std::cout << std::endl;
-            
-            for (int y = 0; y < grid_size; ++y) {
-                std::cout << std::setw(2) << y << "  ";
-                for (int x = 0; x < grid_size; ++x) {
-                    std::cout << grid[y][x];
-                    if (count_grid[y][x] > 1) {
-                        std::cout << std::to_string(count_grid[y][x]);
-                    } else {
-                        std::cout << " ";
-                    }
+                std::cout << symbol;
+                if (total > 1) {
+                    std::cout << std::to_string(total);
+                } else {
                     std::cout << " ";
                 }
-                std::cout << std::endl;
+                std::cout << " ";
             }
-            
-            std::cout << "Legend: B=Bear, I=Bittern, D=Desman, X=Mixed, .=Empty, Number=Count" << std::endl;
+            std::cout << std::endl;
         }
+        
+        std::cout << "Legend: B=Bear, I=Bittern, D=Desman, X=Mixed, .=Empty, Number=Count" << std::endl;
     }
-    
-    std::shared_lock<std::shared_mutex> read_lock(npc_mutex_);
-    auto npcs = editor_.npcs();
-    read_lock.unlock();
+}
+
+void Game::printGameOver() {
+    SnapshotPtr snap = snapshot_.load();
+    const auto& npcs = snap->npcs;
+    const int alive_count = editor_.stats().total();
     
     {
         std::lock_guard<std::mutex> cout_lock(cout_mutex_);
         
         std::cout << "\n" << std::string(50, '=') << std::endl;
         std::cout << "=== GAME OVER ===" << std::endl;
-        std::cout << "Total time: 30 seconds" << std::endl;
-        std::cout << "Survivors (" << alive_count_ << "):" << std::endl;
+        std::cout << "Total time: "
+                  << std::chrono::duration_cast<std::chrono::seconds>(activeElapsed()).count()
+                  << " seconds" << (terminal_ ? " (ended early: no more kills possible)" : "") << std::endl;
+        std::cout << "Survivors (" << alive_count << "):" << std::endl;
         std::cout << std::string(50, '-') << std::endl;
         
         if (npcs.empty()) {
             std::cout << "No survivors! All NPCs were killed." << std::endl;
         } else {
             std::vector<NPCPtr> bears, bitterns, desmans;
+            const auto& stats = editor_.stats();
+            bears.reserve(stats.count(NPCType::Bear));
+            bitterns.reserve(stats.count(NPCType::Bittern));
+            desmans.reserve(stats.count(NPCType::Desman));
             for (const auto& npc : npcs) {
-                std::string type = npc->type();
-                if (type == "Bear") bears.push_back(npc);
-                else if (type == "Bittern") bitterns.push_back(npc);
-                else if (type == "Desman") desmans.push_back(npc);
+                switch (npc->kind()) {
+                    case NPCType::Bear:    bears.push_back(npc); break;
+                    case NPCType::Bittern: bitterns.push_back(npc); break;
+                    case NPCType::Desman:  desmans.push_back(npc); break;
+                }
             }
             
             if (!bears.empty()) {
@@ -366,16 +565,24 @@ void Game::mainWorker() {
         std::cout << std::string(50, '=') << std::endl;
         
         std::cout << "\nFinal Statistics:" << std::endl;
-        std::cout << "Initial NPCs: 50" << std::endl;
-        std::cout << "Survivors: " << alive_count_ << std::endl;
-        std::cout << "Killed: " << (50 - alive_count_) << std::endl;
+        std::cout << "Initial NPCs: " << initial_count_ << std::endl;
+        std::cout << "Survivors: " << alive_count << std::endl;
+        std::cout << "Killed: " << (initial_count_ - alive_count) << std::endl;
         std::cout << "Survival rate: " << std::fixed << std::setprecision(1) 
-                  << (alive_count_ * 100.0 / 50.0) << "%" << std::endl;
+                  << (initial_count_ > 0 ? alive_count * 100.0 / initial_count_ : 0.0) << "%" << std::endl;
+        
+        BattleSliceStats slices = battleSlices();
+        if (slices.slices > 0) {
+            using ms = std::chrono::duration<double, std::milli>;
+            std::cout << "Battle slices: " << slices.slices << " over " << slices.passes << " passes, "
+                      << std::setprecision(3) << ms(slices.total).count() / static_cast<double>(slices.slices)
+                      << " ms mean, " << ms(slices.max).count() << " ms max" << std::endl;
+        }
         
         std::ofstream final_file("final_state.txt");
         if (final_file) {
             final_file << "=== Final Game State ===" << std::endl;
-            final_file << "Survivors: " << alive_count_ << std::endl;
+            final_file << "Survivors: " << alive_count << std::endl;
             for (const auto& npc : npcs) {
                 final_file << npc->type() << " " << npc->name() << " "
                           << npc->x() << " " << npc->y() << std::endl;
@@ -385,16 +592,174 @@ void Game::mainWorker() {
     }
 }
 
-void Game::start() {
+Game::TaskGuard::~TaskGuard() {
+    std::lock_guard<std::mutex> lock(game.tasks_mutex_);
+    --game.active_tasks_;
+    game.tasks_cv_.notify_all();
+}
+
+Task Game::movementTask(std::stop_token stop) {
+    TaskGuard guard{*this};
+    std::uniform_int_distribution<> sleep_dist(50, 200);
+    
+    while (co_await scheduler_->sleepFor(std::chrono::milliseconds(sleep_dist(move_gen_)), stop)) {
+        while (!runStep(&Game::moveStep)) {
+            if (!co_await pause_gate_.wait(stop)) co_return;
+        }
+    }
+}
+
+bool Game::isTerminal() const {
+    return !KillMatrix::standard().canKill(editor_.stats().counts());
+}
+
+Task Game::battleTask(std::stop_token stop) {
+    TaskGuard guard{*this};
+    std::uniform_int_distribution<> sleep_dist(100, 300);
+    
+    while (!isTerminal()) {
+        if (!co_await scheduler_->sleepFor(std::chrono::milliseconds(sleep_dist(battle_gen_)), stop))
+            co_return;
+        while (!runStep(&Game::battleStep)) {
+            if (!co_await pause_gate_.wait(stop)) co_return;
+        }
+    }
+    
+    // Movement can no longer change the outcome: end the game now instead
+    // of running out the clock. The render task prints the result.
+    terminal_ = true;
+    {
+        std::lock_guard<std::mutex> cout_lock(cout_mutex_);
+        std::cout << "[GAME] No more kills possible, ending early" << std::endl;
+    }
+    stop_source_.request_stop();
+    pause_gate_.open();
+}
+
+Task Game::loggingTask(std::stop_token stop) {
+    TaskGuard guard{*this};
+    
+    while (co_await scheduler_->sleepFor(100ms, stop)) {
+        flushLog();
+        publishViews();
+    }
+    flushLog();
+    publishViews();
+}
+
+Task Game::renderTask(std::stop_token stop) {
+    TaskGuard guard{*this};
+    auto duration = 30s;
+    
+    int map_updates = 0;
+    
+    while (running_) {
+        auto elapsed = activeElapsed();
+        if (elapsed >= duration) break;
+        
+        if (!co_await scheduler_->sleepFor(1s, stop)) break;
+        // The clock stands still while paused, so neither is the map redrawn.
+        if (paused_ && !co_await pause_gate_.wait(stop)) break;
+        
+        renderMap(++map_updates, elapsed);
+    }
+    
+    running_ = false;
+    stop_source_.request_stop();
+    pause_gate_.open();
+    printGameOver();
+}
+
+bool Game::runStep(void (Game::*step)()) {
+    std::lock_guard<std::mutex> lock(step_mutex_);
+    if (paused_) return false;
+    (this->*step)();
+    return true;
+}
+
+std::chrono::steady_clock::duration Game::activeElapsed() const {
+    std::lock_guard<std::mutex> lock(step_mutex_);
+    auto now = std::chrono::steady_clock::now();
+    auto elapsed = now - started_at_ - paused_total_;
+    if (paused_) elapsed -= now - paused_at_;
+    return elapsed;
+}
+
+void Game::pause() {
+    if (!running_) throw std::logic_error("Cannot pause a game that is not running");
+    
+    pause_gate_.close();
+    std::lock_guard<std::mutex> lock(step_mutex_);
+    if (paused_) return;
+    paused_ = true;
+    paused_at_ = std::chrono::steady_clock::now();
+}
+
+void Game::resume() {
+    {
+        std::lock_guard<std::mutex> lock(step_mutex_);
+        if (!paused_) return;
+        paused_ = false;
+        paused_total_ += std::chrono::steady_clock::now() - paused_at_;
+    }
+    pause_gate_.open();
+}
+
+void Game::step(int ticks) {
+    if (!running_ || !paused_) throw std::logic_error("Game must be paused to step");
+    
+    for (int i = 0; i < ticks; ++i) {
+        std::lock_guard<std::mutex> lock(step_mutex_);
+        moveStep();
+        battleStep();
+    }
+    flushLog();
+    publishViews();
+}
+
+void Game::start(bool paused) {
     if (running_) return;
     
     running_ = true;
     
-    generateInitialNPCs();
+    if (!resumed_) {
+        // First touch from a pinned worker places the world on its node.
+        if (scheduler_->pinned()) scheduler_->runOnWorker([this] { generateInitialNPCs(); });
+        else generateInitialNPCs();
+    } else {
+        std::lock_guard<std::mutex> cout_lock(cout_mutex_);
+        std::cout << "[GAME] Resumed " << initial_count_ << " NPCs from checkpoint" << std::endl;
+    }
+    
+    move_gen_.seed(gen_());
+    battle_gen_.seed(gen_());
+    resetBattlePass();
+    if (trajectory_) trajectory_->reopen();
+    {
+        std::lock_guard<std::mutex> lock(step_mutex_);
+        started_at_ = std::chrono::steady_clock::now();
+        paused_total_ = {};
+        paused_at_ = started_at_;
+        paused_ = paused;
+    }
+    if (paused) pause_gate_.close();
+    else pause_gate_.open();
+    terminal_ = false;
+    if (!trace_path_.empty()) {
+        traceClear();
+        traceEnable(true);
+        tracing_ = true;
+    }
+    stop_source_ = std::stop_source();
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex_);
+        active_tasks_ = 4;
+    }
     
-    movement_thread_ = std::thread(&Game::movementWorker, this);
-    battle_thread_ = std::thread(&Game::battleWorker, this);
-    main_thread_ = std::thread(&Game::mainWorker, this);
+    scheduler_->spawn(movementTask(stop_source_.get_token()));
+    scheduler_->spawn(battleTask(stop_source_.get_token()));
+    scheduler_->spawn(loggingTask(stop_source_.get_token()));
+    scheduler_->spawn(renderTask(stop_source_.get_token()));
     
     {
         std::lock_guard<std::mutex> cout_lock(cout_mutex_);
@@ -402,12 +767,12 @@ void Game::start() {
         std::cout << "=== MULTI-THREADED NPC GAME STARTED ===" << std::endl;
         std::cout << "Based on Lab 6 Variant 19: Bear, Bittern (Выпь), Desman (Выхухоль)" << std::endl;
         std::cout << std::string(60, '-') << std::endl;
-        std::cout << "Initial NPCs: 50 (randomly generated)" << std::endl;
+        std::cout << "Initial NPCs: " << initial_count_ << (resumed_ ? " (resumed)" : " (randomly generated)") << std::endl;
         std::cout << "Movement distance: " << MOVE_DISTANCE << " units (Desman/Выхухоль)" << std::endl;
         std::cout << "Kill distance: " << KILL_DISTANCE << " units (Desman/Выхухоль)" << std::endl;
         std::cout << "Map size: " << MAP_WIDTH << "x" << MAP_HEIGHT << " units" << std::endl;
-        std::cout << "Game duration: 30 seconds" << std::endl;
-        std::cout << "Threads: Movement, Battle, Main (map display)" << std::endl;
+        std::cout << "Game duration: up to 30 seconds" << std::endl;
+        std::cout << "Tasks: Movement, Battle, Logging, Render on " << scheduler_->threadCount() << " threads" << std::endl;
         std::cout << "Battle rules (Lab 6):" << std::endl;
         std::cout << "  - Bear kills everyone except Bears" << std::endl;
         std::cout << "  - Bittern kills no one" << std::endl;
@@ -418,14 +783,233 @@ void Game::start() {
 
 void Game::stop() {
     running_ = false;
+    stop_source_.request_stop();
+    pause_gate_.open();
+    waitForFinish();
+    if (trajectory_) trajectory_->close();
+    if (tracing_) {
+        tracing_ = false;
+        traceEnable(false);
+        try {
+            writeChromeTrace(trace_path_);
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> cout_lock(cout_mutex_);
+            std::cout << "[GAME] Trace not written: " << e.what() << std::endl;
+        }
+    }
     
-    if (movement_thread_.joinable()) movement_thread_.join();
-    if (battle_thread_.joinable()) battle_thread_.join();
-    if (main_thread_.joinable()) main_thread_.join();
+    std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+    if (checkpoint_thread_.joinable()) checkpoint_thread_.join();
 }
 
-void Game::waitForFinish() {
-    if (main_thread_.joinable()) {
-        main_thread_.join();
+std::vector<NodeStats> Game::nodeStats() const {
+    std::map<int, NodeStats> nodes;
+    for (const auto& w : scheduler_->workerStats()) {
+        auto& n = nodes[w.node];
+        n.node = w.node;
+        ++n.workers;
+        n.resumed += w.resumed;
+    }
+    
+    SnapshotPtr snap = snapshot_.load();
+    std::vector<const void*> addrs;
+    addrs.reserve(snap->npcs.size());
+    for (const auto& npc : snap->npcs) addrs.push_back(npc.get());
+    std::vector<int> where(addrs.size(), -1);
+    numaNodesOf(addrs, where);
+    for (int node : where) {
+        auto& n = nodes[node];
+        n.node = node;
+        ++n.npcs;
+    }
+    
+    std::vector<NodeStats> out;
+    out.reserve(nodes.size());
+    for (const auto& [node, stats] : nodes) out.push_back(stats);
+    return out;
+}
+
+GameResult Game::runHeadless(std::uint64_t seed, std::chrono::milliseconds duration) {
+    if (running_) throw std::logic_error("Cannot run a headless game while running");
+    
+    {
+        std::unique_lock<std::shared_mutex> lock(npc_mutex_);
+        editor_.clear();
+    }
+    {
+        std::lock_guard<std::mutex> log_lock(log_mutex_);
+        pending_rounds_.clear();
+    }
+    battle_round_ = 0;
+    resetBattlePass();
+    resumed_ = false;
+    terminal_ = false;
+    
+    std::seed_seq seq{static_cast<std::uint32_t>(seed), static_cast<std::uint32_t>(seed >> 32)};
+    gen_.seed(seq);
+    generateInitialNPCs();
+    move_gen_.seed(gen_());
+    battle_gen_.seed(gen_());
+    
+    GameResult result;
+    result.seed = seed;
+    result.initial = editor_.stats().counts();
+    
+    if (discrete_events_ || lockstep_) {
+        std::chrono::milliseconds end = lockstep_ ? runLockstep(seed, duration) : runEvents(duration);
+        result.survivors = editor_.stats().counts();
+        result.sim_time = terminal_ ? end : duration;
+        result.ended_early = terminal_;
+        return result;
+    }
+    
+    // Same sleeps as movementTask and battleTask, drawn from the same
+    // generators in the same order.
+    std::uniform_int_distribution<> move_sleep(50, 200);
+    std::uniform_int_distribution<> battle_sleep(100, 300);
+    std::chrono::milliseconds now{0};
+    std::chrono::milliseconds next_move{move_sleep(move_gen_)};
+    std::chrono::milliseconds next_battle{0};
+    // Stands in for the logging task's ticks.
+    std::chrono::milliseconds next_view{100};
+    
+    while (true) {
+        if (isTerminal()) {
+            terminal_ = true;
+            break;
+        }
+        if (next_battle <= now) next_battle = now + std::chrono::milliseconds(battle_sleep(battle_gen_));
+        if (std::min(next_move, next_battle) >= next_view) {
+            publishViews();
+            next_view = std::min(next_move, next_battle) / 100ms * 100ms + 100ms;
+        }
+        
+        if (next_move < next_battle) {
+            if (next_move >= duration) break;
+            now = next_move;
+            moveStep();
+            next_move = now + std::chrono::milliseconds(move_sleep(move_gen_));
+        } else {
+            if (next_battle >= duration) break;
+            now = next_battle;
+            battleStep();
+        }
+    }
+    flushLog();
+    publishViews();
+    
+    result.survivors = editor_.stats().counts();
+    result.sim_time = terminal_ ? now : duration;
+    result.ended_early = terminal_;
+    return result;
+}
+
+std::chrono::milliseconds Game::runEvents(std::chrono::milliseconds duration) {
+    DiscreteEventOptions opts;
+    opts.move_distance = MOVE_DISTANCE;
+    opts.kill_distance = KILL_DISTANCE;
+    opts.width = MAP_WIDTH;
+    opts.height = MAP_HEIGHT;
+    
+    std::unique_lock<std::shared_mutex> lock(npc_mutex_);
+    DiscreteEventSim sim(editor_, battle_gen_(), opts);
+    std::function<void(NPCHandle)> moved;
+    if (changes_) moved = [this](NPCHandle h) { changes_->moved(editor_.idOf(h)); };
+    lock.unlock();
+    
+    std::vector<KillEvent> kills;
+    while (true) {
+        if (isTerminal()) {
+            terminal_ = true;
+            break;
+        }
+        if (sim.nextTime() >= duration) break;
+        
+        lock.lock();
+        sim.step(kills, moved);
+        lock.unlock();
+        if (kills.empty()) continue;
+        
+        KillRound round;
+        round.tick = ++battle_round_;
+        for (const auto& kill : kills) {
+            round.killer_types.push_back(npcTypeName(kill.killer_kind));
+            if (changes_) changes_->removed(kill.victim);
+        }
+        round.events = std::move(kills);
+        kills.clear();
+        std::lock_guard<std::mutex> log_lock(log_mutex_);
+        pending_rounds_.push_back(std::move(round));
     }
-}
\ No newline at end of file
+    
+    // The simulation edits the world behind the builder's back, so only the
+    // final world is published, rebuilt in full.
+    lock.lock();
+    snapshots_.reset(editor_);
+    publishSnapshot();
+    lock.unlock();
+    flushLog();
+    publishViews();
+    return sim.now();
+}
+
+std::chrono::milliseconds Game::runLockstep(std::uint64_t seed, std::chrono::milliseconds duration) {
+    LockstepOptions opts;
+    opts.seed = seed;
+    opts.move_distance = MOVE_DISTANCE;
+    opts.kill_distance = KILL_DISTANCE;
+    opts.width = MAP_WIDTH;
+    opts.height = MAP_HEIGHT;
+    const LockstepRules rules(opts);
+    
+    // Tick t runs at (t - 1) ticks of virtual time; each one stands in for
+    // a logging tick as well.
+    std::chrono::milliseconds now{0};
+    for (int tick = 1; now < duration; ++tick, now += LOCKSTEP_TICK) {
+        if (isTerminal()) {
+            terminal_ = true;
+            break;
+        }
+        TRACE_SCOPE("lockstep.tick");
+        std::unique_lock<std::shared_mutex> lock(npc_mutex_);
+        rules.move(editor_, tick, [this](NPCHandle h) {
+            if (changes_) changes_->moved(editor_.idOf(h));
+            snapshots_.moved(h, editor_.find(h));
+        });
+        
+        KillRound round;
+        auto kills = rules.battle(editor_, tick);
+        for (const auto& kill : kills) {
+            NPCPtr killer = editor_.find(kill.killer);
+            NPCPtr victim = editor_.find(kill.victim);
+            round.events.push_back({.killer = editor_.idOf(kill.killer), .victim = editor_.idOf(kill.victim),
+                                    .killer_kind = killer->kind(), .victim_kind = victim->kind(),
+                                    .x = victim->x(), .y = victim->y()});
+            round.killer_types.push_back(npcTypeName(killer->kind()));
+        }
+        // Every victim is distinct and alive: the rules kill each NPC once.
+        for (const auto& kill : kills) {
+            NPCId id = editor_.idOf(kill.victim);
+            editor_.kill(kill.victim);
+            snapshots_.removed(kill.victim);
+            if (changes_) changes_->removed(id);
+        }
+        editor_.compactIfSparse();
+        publishSnapshot();
+        lock.unlock();
+        publishViews();
+        
+        if (round.events.empty()) continue;
+        round.tick = ++battle_round_;
+        std::lock_guard<std::mutex> log_lock(log_mutex_);
+        pending_rounds_.push_back(std::move(round));
+    }
+    flushLog();
+    publishViews();
+    return now;
+}
+
+void Game::waitForFinish() {
+    std::unique_lock<std::mutex> lock(tasks_mutex_);
+    tasks_cv_.wait(lock, [this] { return active_tasks_ == 0; });
+}
@@ -0,0 +1,37 @@
+#include "KillMatrix.h"
+#include "NPCFactory.h"
+#include "FightRules.h"
+
+KillMatrix::KillMatrix(FightVisitor &rules) {
+    for (std::size_t a = 0; a < NPC_TYPE_COUNT; ++a) {
+        for (std::size_t b = 0; b < NPC_TYPE_COUNT; ++b) {
+            auto attacker = NPCFactory::create(static_cast<NPCType>(a), "attacker", 0, 0);
+            auto defender = NPCFactory::create(static_cast<NPCType>(b), "defender", 0, 0);
+            kills_[a][b] = attacker->accept(rules, *defender);
+        }
+    }
+
+    for (std::size_t a = 0; a < NPC_TYPE_COUNT; ++a) {
+        for (std::size_t b = a; b < NPC_TYPE_COUNT; ++b) {
+            if (kills_[a][b] || kills_[b][a])
+                pairs_.emplace_back(static_cast<NPCType>(a), static_cast<NPCType>(b));
+        }
+    }
+}
+
+const KillMatrix& KillMatrix::standard() {
+    static const KillMatrix matrix = [] {
+        FightRules rules;
+        return KillMatrix(rules);
+    }();
+    return matrix;
+}
+
+bool KillMatrix::canKill(const std::array<int, NPC_TYPE_COUNT> &counts) const {
+    for (auto [a, b] : pairs_) {
+        int na = counts[slot(a)];
+        int nb = counts[slot(b)];
+        if (a == b ? na >= 2 : na > 0 && nb > 0) return true;
+    }
+    return false;
+}
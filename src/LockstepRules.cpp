@@ -0,0 +1,101 @@
+#include "LockstepRules.h"
+#include "KillMatrix.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string_view>
+
+namespace {
+
+// splitmix64 finalizer.
+std::uint64_t mix(std::uint64_t z) {
+    z += 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// FNV-1a of the name: the same key for an NPC in every process.
+std::uint64_t keyOf(std::string_view name) {
+    std::uint64_t h = 0xcbf29ce484222325ull;
+    for (char c : name) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+// Moves use (key, key), fights (lower key, higher key).
+std::uint64_t draw(std::uint64_t seed, int tick, std::uint64_t a, std::uint64_t b) {
+    return mix(mix(mix(mix(seed) ^ static_cast<std::uint64_t>(tick)) ^ a) ^ b);
+}
+
+double unit(std::uint64_t h) {
+    return static_cast<double>(h >> 11) * 0x1.0p-53;
+}
+
+int die(std::uint64_t h, int k) {
+    return 1 + static_cast<int>(mix(h + static_cast<std::uint64_t>(k)) % 6);
+}
+
+} // namespace
+
+LockstepRules::LockstepRules(LockstepOptions opts) : opts_(opts) {
+    if (opts_.move_distance < 0 || opts_.kill_distance < 0 || opts_.width <= 0 || opts_.height <= 0)
+        throw std::invalid_argument("Invalid lockstep options");
+}
+
+void LockstepRules::move(Editor &world, int tick, const std::function<void(NPCHandle)> &moved) const {
+    const auto &npcs = world.npcs();
+    const auto &handles = world.handles();
+    for (size_t i = 0; i < npcs.size(); ++i) {
+        if (!npcs[i]) continue;
+        const NPC &npc = *npcs[i];
+        std::uint64_t key = keyOf(npc.name());
+        std::uint64_t h = draw(opts_.seed, tick, key, key);
+        double x = std::clamp(npc.x() + (unit(mix(h)) * 2 - 1) * opts_.move_distance, 0.0, opts_.width);
+        double y = std::clamp(npc.y() + (unit(mix(h + 1)) * 2 - 1) * opts_.move_distance, 0.0, opts_.height);
+        // Swaps in a clone: `npc` must not be used after this.
+        if (world.moveNPC(handles[i], x, y) && moved) moved(handles[i]);
+    }
+}
+
+std::vector<LockstepKill> LockstepRules::battle(const Editor &world, int tick,
+                                                const std::function<bool(NPCHandle)> &victim) const {
+    const KillMatrix &matrix = KillMatrix::standard();
+    const auto &npcs = world.npcs();
+    const auto &handles = world.handles();
+
+    // Victims in name order, so the kills come out in the same order from
+    // any process that holds them.
+    std::vector<size_t> order;
+    for (size_t i = 0; i < npcs.size(); ++i) {
+        if (npcs[i] && (!victim || victim(handles[i]))) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return npcs[a]->name() < npcs[b]->name(); });
+
+    std::vector<LockstepKill> kills;
+    std::vector<std::pair<const NPC*, NPCHandle>> attackers;
+    for (size_t i : order) {
+        const NPC &target = *npcs[i];
+        attackers.clear();
+        world.queryRadius(target.x(), target.y(), opts_.kill_distance, [&](NPCHandle h, const NPC &npc) {
+            if (h != handles[i] && matrix.kills(npc.kind(), target.kind())) attackers.emplace_back(&npc, h);
+        });
+        // Grid order depends on what else the world holds; names do not.
+        std::sort(attackers.begin(), attackers.end(),
+                  [](const auto &a, const auto &b) { return a.first->name() < b.first->name(); });
+
+        const std::uint64_t target_key = keyOf(target.name());
+        for (auto [npc, h] : attackers) {
+            std::uint64_t key = keyOf(npc->name());
+            std::uint64_t roll = draw(opts_.seed, tick, std::min(key, target_key), std::max(key, target_key));
+            int attack = die(roll, key < target_key ? 0 : 1);
+            int defense = die(roll, target_key < key ? 2 : 3);
+            if (attack > defense) {
+                kills.push_back({h, handles[i]});
+                break;
+            }
+        }
+    }
+    return kills;
+}
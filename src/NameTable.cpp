@@ -0,0 +1,32 @@
+#include "NameTable.h"
+#include <stdexcept>
+#include <utility>
+
+NameTable::NameTable(const NameTable &other) : names_(other.names_) {
+    for (size_t i = 0; i < names_.size(); ++i)
+        ids_.emplace(names_[i], static_cast<NPCId>(i));
+}
+
+NameTable& NameTable::operator=(NameTable other) noexcept {
+    names_.swap(other.names_);
+    ids_.swap(other.ids_);
+    return *this;
+}
+
+NPCId NameTable::intern(std::string_view name) {
+    auto it = ids_.find(name);
+    if (it != ids_.end()) return it->second;
+
+    if (names_.size() >= INVALID_NPC_ID)
+        throw std::length_error("Name table is full");
+
+    NPCId id = static_cast<NPCId>(names_.size());
+    names_.emplace_back(name);
+    ids_.emplace(names_.back(), id);
+    return id;
+}
+
+NPCId NameTable::find(std::string_view name) const {
+    auto it = ids_.find(name);
+    return it == ids_.end() ? INVALID_NPC_ID : it->second;
+}
@@ -2,13 +2,44 @@
 #include <iostream>
 #include <fstream>
 
+void FightObserver::onKills(std::span<const KillEvent> events) {
+    for (auto &e : events)
+        onKill(std::string(e.killer_name), std::string(e.victim_name));
+}
+
+static std::string formatKills(std::span<const KillEvent> events, std::string_view prefix) {
+    std::string buf;
+    buf.reserve(events.size() * 32);
+    for (auto &e : events) {
+        buf += prefix;
+        buf += e.killer_name;
+        buf += " killed ";
+        buf += e.victim_name;
+        buf += '\n';
+    }
+    return buf;
+}
+
 void ConsoleObserver::onKill(const std::string &killer, const std::string &victim) {
     std::cout << "[EVENT] " << killer << " killed " << victim << "\n";
 }
 
+void ConsoleObserver::onKills(std::span<const KillEvent> events) {
+    if (events.empty()) return;
+    std::string buf = formatKills(events, "[EVENT] ");
+    std::cout.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+}
+
 FileObserver::FileObserver(const std::string &fname) : filename_(fname) {}
 
 void FileObserver::onKill(const std::string &killer, const std::string &victim) {
     std::ofstream out(filename_, std::ios::app);
     out << killer << " killed " << victim << "\n";
-}
\ No newline at end of file
+}
+
+void FileObserver::onKills(std::span<const KillEvent> events) {
+    if (events.empty()) return;
+    std::string buf = formatKills(events, "");
+    std::ofstream out(filename_, std::ios::app);
+    out.write(buf.data(), static_cast<std::streamsize>(buf.size()));
+}
@@ -0,0 +1,62 @@
+#include "Placement.h"
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+std::vector<int> allowedCpus() {
+    std::vector<int> cpus;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) != 0) return cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+        if (CPU_ISSET(cpu, &set)) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+bool pinCurrentThread(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+int currentCpu() {
+    return sched_getcpu();
+}
+
+int numaNodeOfCpu(int cpu) {
+    // Each CPU directory holds a "nodeN" link to its node.
+    std::error_code ec;
+    std::filesystem::directory_iterator it("/sys/devices/system/cpu/cpu" + std::to_string(cpu), ec);
+    for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+            std::all_of(name.begin() + 4, name.end(), [](char c) { return c >= '0' && c <= '9'; }))
+            return std::stoi(name.substr(4));
+    }
+    return 0;
+}
+
+void numaNodesOf(std::span<const void* const> addrs, std::span<int> nodes) {
+    const size_t n = std::min(addrs.size(), nodes.size());
+    if (n == 0) return;
+
+    const auto page = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+    std::vector<void*> pages(n);
+    for (size_t i = 0; i < n; ++i)
+        pages[i] = reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(addrs[i]) & ~(page - 1));
+
+    // With no target nodes move_pages only reports where each page lives.
+    long rc = syscall(SYS_move_pages, 0, static_cast<unsigned long>(n), pages.data(), nullptr, nodes.data(), 0);
+    if (rc != 0) std::fill_n(nodes.begin(), n, -1);
+    for (size_t i = 0; i < n; ++i) {
+        if (nodes[i] < 0) nodes[i] = -1;
+    }
+}
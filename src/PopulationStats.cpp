@@ -0,0 +1,57 @@
+#include "PopulationStats.h"
+#include <algorithm>
+#include <stdexcept>
+
+int PopulationStats::regionOf(double x, double y) const {
+    int col = std::clamp(static_cast<int>((x / width_) * cols_), 0, cols_ - 1);
+    int row = std::clamp(static_cast<int>((y / height_) * rows_), 0, rows_ - 1);
+    return row * cols_ + col;
+}
+
+void PopulationStats::bump(NPCType t, double x, double y, int delta) {
+    by_type_[slot(t)].fetch_add(delta, std::memory_order_relaxed);
+    total_.fetch_add(delta, std::memory_order_relaxed);
+    if (hasRegions())
+        regions_[regionOf(x, y) * NPC_TYPE_COUNT + slot(t)].fetch_add(delta, std::memory_order_relaxed);
+}
+
+void PopulationStats::onMove(NPCType t, double from_x, double from_y, double to_x, double to_y) {
+    if (!hasRegions()) return;
+
+    int from = regionOf(from_x, from_y);
+    int to = regionOf(to_x, to_y);
+    if (from == to) return;
+
+    regions_[from * NPC_TYPE_COUNT + slot(t)].fetch_sub(1, std::memory_order_relaxed);
+    regions_[to * NPC_TYPE_COUNT + slot(t)].fetch_add(1, std::memory_order_relaxed);
+}
+
+void PopulationStats::clear() {
+    for (auto &c : by_type_) c.store(0, std::memory_order_relaxed);
+    total_.store(0, std::memory_order_relaxed);
+    for (auto &c : regions_) c.store(0, std::memory_order_relaxed);
+}
+
+void PopulationStats::enableRegions(int cols, int rows, double width, double height) {
+    if (cols <= 0 || rows <= 0 || width <= 0 || height <= 0)
+        throw std::invalid_argument("Invalid region grid");
+
+    cols_ = cols;
+    rows_ = rows;
+    width_ = width;
+    height_ = height;
+    regions_ = std::vector<std::atomic<int>>(static_cast<std::size_t>(cols) * rows * NPC_TYPE_COUNT);
+    clear();
+}
+
+int PopulationStats::regionCount(int col, int row, NPCType t) const {
+    if (!hasRegions() || col < 0 || col >= cols_ || row < 0 || row >= rows_) return 0;
+    return regions_[(row * cols_ + col) * NPC_TYPE_COUNT + slot(t)].load(std::memory_order_relaxed);
+}
+
+int PopulationStats::regionCount(int col, int row) const {
+    int sum = 0;
+    for (std::size_t t = 0; t < NPC_TYPE_COUNT; ++t)
+        sum += regionCount(col, row, static_cast<NPCType>(t));
+    return sum;
+}
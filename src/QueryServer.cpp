@@ -0,0 +1,385 @@
+#include "QueryServer.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static constexpr size_t MAX_LINE = 4096;
+// A client that lets this much output pile up is dropped.
+static constexpr size_t MAX_PENDING = 8 << 20;
+
+static void appendNumber(std::string &out, double v) {
+    char buf[32];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::fixed, 2);
+    out.append(buf, ec == std::errc() ? end : buf);
+}
+
+static void appendRow(std::string &out, NPCId id, const NPC &npc) {
+    out += std::to_string(id);
+    out += ' ';
+    out += npcTypeName(npc.kind());
+    out += ' ';
+    out += npc.name();
+    out += ' ';
+    appendNumber(out, npc.x());
+    out += ' ';
+    appendNumber(out, npc.y());
+    out += '\n';
+}
+
+static std::runtime_error sysError(const std::string &what) {
+    return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+QueryServer::QueryServer(const std::string &path, const std::atomic<SnapshotPtr> &snapshot,
+                         const PopulationStats &stats, const ChangeLog *changes, QueryServerOptions opts)
+    : path_(path), snapshot_(snapshot), stats_(stats), changes_(changes), opts_(opts) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path))
+        throw std::invalid_argument("Invalid query socket path: " + path);
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ::unlink(path.c_str());
+    if (listen_fd_ < 0 || epoll_fd_ < 0 || wake_fd_ < 0 ||
+        ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        ::listen(listen_fd_, SOMAXCONN) != 0) {
+        auto err = sysError("Cannot listen on " + path);
+        for (int fd : {listen_fd_, epoll_fd_, wake_fd_}) if (fd >= 0) ::close(fd);
+        throw err;
+    }
+
+    for (int fd : {listen_fd_, wake_fd_}) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+    thread_ = std::thread([this] { run(); });
+}
+
+QueryServer::~QueryServer() {
+    stopping_ = true;
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto n = ::write(wake_fd_, &one, sizeof(one));
+    thread_.join();
+
+    for (auto &[fd, c] : clients_) ::close(fd);
+    ::close(listen_fd_);
+    ::close(wake_fd_);
+    ::close(epoll_fd_);
+    ::unlink(path_.c_str());
+}
+
+void QueryServer::notify() {
+    if (wake_pending_.exchange(true, std::memory_order_acq_rel)) return;
+    std::uint64_t one = 1;
+    [[maybe_unused]] auto n = ::write(wake_fd_, &one, sizeof(one));
+}
+
+void QueryServer::run() {
+    epoll_event events[256];
+    while (!stopping_) {
+        int n = ::epoll_wait(epoll_fd_, events, 256, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listen_fd_) {
+                accept();
+            } else if (fd == wake_fd_) {
+                std::uint64_t count;
+                [[maybe_unused]] auto r = ::read(wake_fd_, &count, sizeof(count));
+                // Cleared before loading, so a publish racing with us wakes
+                // us again instead of being missed.
+                wake_pending_.store(false, std::memory_order_release);
+                if (stopping_) break;
+                publishToSubscribers();
+            } else {
+                auto it = clients_.find(fd);
+                if (it == clients_.end()) continue;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) readFrom(fd, it->second);
+                else if (events[i].events & EPOLLOUT) flush(fd, it->second);
+            }
+        }
+    }
+}
+
+void QueryServer::accept() {
+    while (true) {
+        int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;
+
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+            ::close(fd);
+            continue;
+        }
+        clients_[fd] = Client{};
+        ++client_count_;
+    }
+}
+
+void QueryServer::close(int fd) {
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    clients_.erase(fd);
+    --client_count_;
+}
+
+void QueryServer::readFrom(int fd, Client &c) {
+    char buf[4096];
+    bool eof = false;
+    while (true) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n > 0) {
+            c.in.append(buf, static_cast<size_t>(n));
+            continue;
+        }
+        if (n == 0) {
+            // Half-closed: answer what was sent, then hang up.
+            eof = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        close(fd);
+        return;
+    }
+
+    size_t start = 0;
+    for (size_t nl; !c.closing && (nl = c.in.find('\n', start)) != std::string::npos; start = nl + 1) {
+        std::string line = c.in.substr(start, nl - start);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        handle(c, line);
+    }
+    c.in.erase(0, start);
+    if (c.in.size() > MAX_LINE) {
+        c.out += "ERR line too long\n";
+        c.closing = true;
+    }
+    if (eof) c.closing = true;
+    flush(fd, c);
+}
+
+void QueryServer::handle(Client &c, const std::string &line) {
+    std::istringstream in(line);
+    std::string cmd;
+    in >> cmd;
+
+    if (cmd == "STATS") {
+        SnapshotPtr snap = snapshot_.load();
+        auto counts = stats_.counts();
+        c.out += "STATS " + std::to_string(snap->version) + ' ' + std::to_string(stats_.total());
+        for (int n : counts) c.out += ' ' + std::to_string(n);
+        c.out += '\n';
+    } else if (cmd == "SNAPSHOT") {
+        refresh();
+        c.out += snapshotFrame();
+    } else if (cmd == "REGION") {
+        double x0, y0, x1, y1;
+        if (!(in >> x0 >> y0 >> x1 >> y1)) {
+            c.out += "ERR usage: REGION x0 y0 x1 y1\n";
+            return;
+        }
+        SnapshotPtr snap = snapshot_.load();
+        std::string rows;
+        size_t n = 0;
+        for (size_t i = 0; i < snap->npcs.size(); ++i) {
+            const NPC &npc = *snap->npcs[i];
+            if (npc.x() < x0 || npc.x() > x1 || npc.y() < y0 || npc.y() > y1) continue;
+            appendRow(rows, snap->ids[i], npc);
+            ++n;
+        }
+        c.out += "REGION " + std::to_string(snap->version) + ' ' + std::to_string(n) + '\n';
+        c.out += rows;
+    } else if (cmd == "SUBSCRIBE") {
+        c.subscribed = true;
+        c.last_version = 0;
+        c.out += subscriberFrame(c);
+    } else if (cmd == "QUIT") {
+        c.closing = true;
+    } else {
+        c.out += "ERR unknown command\n";
+    }
+}
+
+void QueryServer::refresh() {
+    SnapshotPtr snap = snapshot_.load();
+    // Holding frame_snap_ keeps Game from recycling it, so pointer equality
+    // means the caches are current.
+    if (snap == frame_snap_) return;
+
+    frame_snap_ = std::move(snap);
+    rows_.clear();
+    frame_.clear();
+    key_frame_.clear();
+    index_.clear();
+    deltas_.clear();
+}
+
+const std::string& QueryServer::snapshotFrame() {
+    if (frame_.empty()) {
+        if (rows_.empty()) {
+            for (size_t i = 0; i < frame_snap_->npcs.size(); ++i)
+                appendRow(rows_, frame_snap_->ids[i], *frame_snap_->npcs[i]);
+        }
+        frame_ = "SNAPSHOT " + std::to_string(frame_snap_->version) + ' ' +
+                 std::to_string(frame_snap_->npcs.size()) + '\n' + rows_;
+    }
+    return frame_;
+}
+
+const std::string& QueryServer::keyFrame() {
+    // Same rows as SNAPSHOT under a different header.
+    const std::string &snapshot = snapshotFrame();
+    if (key_frame_.empty())
+        key_frame_ = "KEY" + snapshot.substr(snapshot.find(' '));
+    return key_frame_;
+}
+
+const std::string& QueryServer::subscriberFrame(Client &c) {
+    refresh();
+    const WorldSnapshot &snap = *frame_snap_;
+    const std::uint64_t from = c.last_version;
+
+    bool key = !changes_ || from == 0 || snap.version - c.last_key >= opts_.keyframe_interval;
+    if (!key) {
+        auto it = deltas_.find(from);
+        if (it == deltas_.end() && changes_->collect(from, snap.version, scratch_)) {
+            if (index_.empty()) {
+                NPCId max_id = 0;
+                for (NPCId id : snap.ids) max_id = std::max(max_id, id);
+                index_.assign(static_cast<size_t>(max_id) + 1, -1);
+                for (size_t i = 0; i < snap.ids.size(); ++i) index_[snap.ids[i]] = static_cast<std::int32_t>(i);
+            }
+            auto row = [&](NPCId id) { return id < index_.size() ? index_[id] : -1; };
+
+            std::string body;
+            size_t moved = 0, removed = 0, spawned = 0;
+            for (NPCId id : scratch_.moved) {
+                std::int32_t i = row(id);
+                if (i < 0 || std::binary_search(scratch_.spawned.begin(), scratch_.spawned.end(), id)) continue;
+                const NPC &npc = *snap.npcs[static_cast<size_t>(i)];
+                body += std::to_string(id) + ' ' + std::to_string(std::llround(npc.x() * 100.0)) + ' ' +
+                        std::to_string(std::llround(npc.y() * 100.0)) + '\n';
+                ++moved;
+            }
+            for (NPCId id : scratch_.removed) {
+                if (row(id) >= 0) continue;
+                body += std::to_string(id) + '\n';
+                ++removed;
+            }
+            for (NPCId id : scratch_.spawned) {
+                std::int32_t i = row(id);
+                if (i < 0) continue;
+                appendRow(body, id, *snap.npcs[static_cast<size_t>(i)]);
+                ++spawned;
+            }
+
+            std::string frame = "DELTA " + std::to_string(from) + ' ' + std::to_string(snap.version) + ' ' +
+                                std::to_string(moved) + ' ' + std::to_string(removed) + ' ' +
+                                std::to_string(spawned) + '\n' + body;
+            it = deltas_.emplace(from, std::move(frame)).first;
+        }
+        if (it != deltas_.end()) {
+            c.last_version = snap.version;
+            ++delta_frames_;
+            return it->second;
+        }
+    }
+
+    c.last_version = c.last_key = snap.version;
+    ++key_frames_;
+    return keyFrame();
+}
+
+void QueryServer::publishToSubscribers() {
+    std::vector<int> ready;
+    for (auto &[fd, c] : clients_) {
+        // Clients still draining an older frame catch up in flush().
+        if (c.subscribed && c.out.empty()) ready.push_back(fd);
+    }
+    if (ready.empty()) return;
+
+    refresh();
+    for (int fd : ready) {
+        auto it = clients_.find(fd);
+        if (it == clients_.end() || it->second.last_version >= frame_snap_->version) continue;
+        send(fd, it->second, subscriberFrame(it->second));
+    }
+}
+
+bool QueryServer::send(int fd, Client &c, const std::string &data) {
+    // Send straight from the shared frame; only a remainder is copied.
+    ssize_t n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        close(fd);
+        return false;
+    }
+    size_t sent = n > 0 ? static_cast<size_t>(n) : 0;
+    bytes_sent_ += sent;
+    if (sent == data.size()) return true;
+    c.out.assign(data, sent);
+    flush(fd, c);
+    return true;
+}
+
+void QueryServer::flush(int fd, Client &c) {
+    while (c.sent < c.out.size()) {
+        ssize_t n = ::send(fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+        if (n > 0) {
+            c.sent += static_cast<size_t>(n);
+            bytes_sent_ += static_cast<std::uint64_t>(n);
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && c.out.size() - c.sent <= MAX_PENDING) {
+            if (!c.waiting_writable) {
+                epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLOUT;
+                ev.data.fd = fd;
+                ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+                c.waiting_writable = true;
+            }
+            return;
+        }
+        close(fd);
+        return;
+    }
+
+    c.out.clear();
+    c.sent = 0;
+    if (c.closing) {
+        close(fd);
+        return;
+    }
+    if (c.waiting_writable) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &ev);
+        c.waiting_writable = false;
+    }
+    // A subscriber that fell behind gets one frame up to the latest version.
+    if (!c.subscribed) return;
+    refresh();
+    if (c.last_version < frame_snap_->version) send(fd, c, subscriberFrame(c));
+}
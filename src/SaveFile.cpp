@@ -0,0 +1,249 @@
+#include "SaveFile.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+
+    struct stat st {};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + path + ": " + std::strerror(errno));
+    }
+    size_ = static_cast<std::size_t>(st.st_size);
+
+    if (size_ > 0) {
+        data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data_ == MAP_FAILED) {
+            data_ = nullptr;
+            ::close(fd);
+            throw std::runtime_error("mmap failed: " + std::string(std::strerror(errno)));
+        }
+        ::madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+    ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) ::munmap(data_, size_);
+}
+
+void parallelFor(std::size_t tasks, const std::function<void(std::size_t)> &fn) {
+    if (tasks == 0) return;
+
+    std::vector<std::thread> workers;
+    workers.reserve(tasks - 1);
+    for (std::size_t i = 0; i + 1 < tasks; ++i)
+        workers.emplace_back(fn, i);
+    fn(tasks - 1);
+    for (auto &t : workers) t.join();
+}
+
+std::vector<std::string_view> splitLines(std::string_view text, std::size_t parts) {
+    std::vector<std::string_view> chunks;
+    if (text.empty()) return chunks;
+    if (parts == 0) parts = 1;
+
+    std::size_t begin = 0;
+    for (std::size_t i = 1; i <= parts && begin < text.size(); ++i) {
+        std::size_t end = text.size();
+        if (i < parts) {
+            end = std::max(begin, text.size() / parts * i);
+            std::size_t nl = text.find('\n', end);
+            end = nl == std::string_view::npos ? text.size() : nl + 1;
+        }
+        chunks.push_back(text.substr(begin, end - begin));
+        begin = end;
+    }
+    return chunks;
+}
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+}
+
+static std::string_view nextToken(std::string_view text, std::size_t &pos) {
+    while (pos < text.size() && isSpace(text[pos])) ++pos;
+    std::size_t start = pos;
+    while (pos < text.size() && !isSpace(text[pos])) ++pos;
+    return text.substr(start, pos - start);
+}
+
+std::size_t countTokens(std::string_view text) {
+    std::size_t count = 0, pos = 0;
+    while (!nextToken(text, pos).empty()) ++count;
+    return count;
+}
+
+std::vector<std::string_view> splitRecords(std::string_view text, std::size_t parts) {
+    static constexpr std::size_t TOKENS_PER_RECORD = 4;
+
+    auto lines = splitLines(text, parts);
+    std::vector<std::size_t> tokens(lines.size());
+    parallelFor(lines.size(), [&](std::size_t c) { tokens[c] = countTokens(lines[c]); });
+
+    // Move each cut past the tokens that finish the record open at it.
+    std::vector<std::size_t> cuts{0};
+    std::size_t before = 0;
+    for (std::size_t c = 1; c < lines.size(); ++c) {
+        before += tokens[c - 1];
+        std::size_t pos = static_cast<std::size_t>(lines[c].data() - text.data());
+        for (std::size_t open = (TOKENS_PER_RECORD - before % TOKENS_PER_RECORD) % TOKENS_PER_RECORD; open > 0; --open)
+            nextToken(text, pos);
+        cuts.push_back(std::max(pos, cuts.back()));
+    }
+    cuts.push_back(text.size());
+
+    std::vector<std::string_view> chunks;
+    for (std::size_t c = 0; c + 1 < cuts.size(); ++c) {
+        if (cuts[c + 1] > cuts[c]) chunks.push_back(text.substr(cuts[c], cuts[c + 1] - cuts[c]));
+    }
+    return chunks;
+}
+
+static bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (std::size_t i = 0; i < a.size(); ++i) {
+        char c = a[i];
+        if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+        if (c != b[i]) return false;
+    }
+    return true;
+}
+
+// Same numbers as `in >> value`, which also takes one leading '+' that
+// from_chars does not.
+static bool parseDouble(std::string_view token, double &value) {
+    if (!token.empty() && token[0] == '+') {
+        token.remove_prefix(1);
+        if (!token.empty() && token[0] == '-') return false;
+    }
+    if (token.empty()) return false;
+    auto [end, ec] = std::from_chars(token.data(), token.data() + token.size(), value);
+    return ec == std::errc() && end == token.data() + token.size();
+}
+
+void parseNPCRecords(std::string_view text, std::vector<NPCRecord> &out) {
+    std::size_t pos = 0;
+    while (true) {
+        std::string_view type = nextToken(text, pos);
+        if (type.empty()) return;
+
+        NPCRecord r;
+        r.name = nextToken(text, pos);
+        if (r.name.empty() || !parseDouble(nextToken(text, pos), r.x) || !parseDouble(nextToken(text, pos), r.y))
+            throw std::runtime_error("Bad NPC format");
+
+        if (equalsIgnoreCase(type, "bear"))         r.type = NPCType::Bear;
+        else if (equalsIgnoreCase(type, "bittern")) r.type = NPCType::Bittern;
+        else if (equalsIgnoreCase(type, "desman"))  r.type = NPCType::Desman;
+        else throw std::runtime_error("Unknown NPC type: " + std::string(type));
+
+        out.push_back(r);
+    }
+}
+
+static void appendDouble(std::string &out, double v) {
+    char buf[32];
+    auto [end, ec] = std::to_chars(buf, buf + sizeof buf, v, std::chars_format::general, 6);
+    out.append(buf, end);
+}
+
+void appendNPCRecord(std::string &out, const NPC &npc) {
+    out += npcTypeName(npc.kind());
+    out += ' ';
+    out += npc.name();
+    out += ' ';
+    appendDouble(out, npc.x());
+    out += ' ';
+    appendDouble(out, npc.y());
+    out += '\n';
+}
+
+static void writeAll(int fd, std::vector<std::string> &buffers, const std::string &path) {
+    std::vector<iovec> iov;
+    for (auto &b : buffers) {
+        if (!b.empty()) iov.push_back({b.data(), b.size()});
+    }
+
+    size_t first = 0;
+    while (first < iov.size()) {
+        int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+        ssize_t n = ::writev(fd, iov.data() + first, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Failed to write " + path + ": " + std::strerror(errno));
+        }
+        // Skip fully written buffers and trim a partially written one.
+        size_t left = static_cast<size_t>(n);
+        while (first < iov.size() && left >= iov[first].iov_len) {
+            left -= iov[first].iov_len;
+            ++first;
+        }
+        if (left > 0) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+        }
+    }
+}
+
+void writeNPCFile(const std::vector<NPCPtr> &npcs, const std::string &path, unsigned threads) {
+    static constexpr size_t MIN_SLICE = 16 * 1024;
+
+    if (threads == 0) {
+        size_t by_size = npcs.size() / MIN_SLICE + 1;
+        threads = static_cast<unsigned>(std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), by_size));
+    }
+    const size_t parts = std::max<size_t>(1, std::min<size_t>(threads, npcs.size()));
+
+    std::vector<std::string> buffers(parts);
+    parallelFor(parts, [&](size_t p) {
+        size_t begin = npcs.size() * p / parts;
+        size_t end = npcs.size() * (p + 1) / parts;
+        std::string &out = buffers[p];
+        out.reserve((end - begin) * 32);
+        for (size_t i = begin; i < end; ++i) {
+            if (npcs[i]) appendNPCRecord(out, *npcs[i]);
+        }
+    });
+
+    const std::string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) throw std::runtime_error("Cannot open " + tmp + ": " + std::strerror(errno));
+    try {
+        writeAll(fd, buffers, tmp);
+        // The data must be on disk before the rename can expose it.
+        if (::fsync(fd) != 0) throw std::runtime_error("Cannot sync " + tmp + ": " + std::strerror(errno));
+    } catch (...) {
+        ::close(fd);
+        ::unlink(tmp.c_str());
+        throw;
+    }
+    if (::close(fd) != 0) {
+        ::unlink(tmp.c_str());
+        throw std::runtime_error("Failed to write " + tmp + ": " + std::strerror(errno));
+    }
+    std::filesystem::rename(tmp, path);
+
+    // The rename itself is only durable once the directory entry is.
+    std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    if (dir.empty()) dir = ".";
+    int dir_fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) throw std::runtime_error("Cannot open " + dir.string() + ": " + std::strerror(errno));
+    int synced = ::fsync(dir_fd);
+    int sync_errno = errno;
+    ::close(dir_fd);
+    if (synced != 0) throw std::runtime_error("Cannot sync " + dir.string() + ": " + std::strerror(sync_errno));
+}
@@ -0,0 +1,156 @@
+#include "Scheduler.h"
+#include "Placement.h"
+#include "Trace.h"
+#include <algorithm>
+#include <future>
+#include <stdexcept>
+#include <string>
+
+Scheduler::Scheduler(unsigned threads, std::vector<int> cpus)
+    : workers_(std::max(threads, 1u)) {
+    if (!cpus.empty()) {
+        auto allowed = allowedCpus();
+        for (int cpu : cpus) {
+            if (std::find(allowed.begin(), allowed.end(), cpu) == allowed.end())
+                throw std::invalid_argument("CPU " + std::to_string(cpu) + " is not available");
+        }
+        for (size_t i = 0; i < workers_.size(); ++i) {
+            workers_[i].cpu = cpus[i % cpus.size()];
+            workers_[i].node = numaNodeOfCpu(workers_[i].cpu);
+        }
+    }
+    for (size_t i = 0; i < workers_.size(); ++i)
+        threads_.emplace_back(&Scheduler::workerLoop, this, i);
+}
+
+Scheduler::~Scheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto &t : threads_) t.join();
+}
+
+void Scheduler::spawn(Task task) {
+    post(task.release());
+}
+
+void Scheduler::post(std::coroutine_handle<> h) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_.push_back(h);
+    }
+    cv_.notify_one();
+}
+
+void Scheduler::fire(const TimerPtr &state) {
+    if (state->fired.exchange(true)) return;
+    release(state);
+}
+
+void Scheduler::release(const TimerPtr &state) {
+    if (state->gate.fetch_sub(1) == 1) post(state->handle);
+}
+
+void Scheduler::addTimer(Clock::time_point deadline, TimerPtr state) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        timers_.push({deadline, std::move(state)});
+    }
+    cv_.notify_one();
+}
+
+void Scheduler::SleepAwaiter::await_suspend(std::coroutine_handle<> h) {
+    state_ = std::make_shared<TimerState>();
+    state_->handle = h;
+    scheduler_.addTimer(deadline_, state_);
+    callback_.emplace(token_, Waker{&scheduler_, state_});
+    // Last use of this awaiter before the coroutine may resume elsewhere.
+    TimerPtr state = state_;
+    scheduler_.release(state);
+}
+
+void Scheduler::Gate::open() {
+    std::vector<std::coroutine_handle<>> waiters;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = true;
+        waiters.swap(waiters_);
+    }
+    for (auto h : waiters) scheduler_.post(h);
+}
+
+void Scheduler::Gate::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    open_ = false;
+}
+
+bool Scheduler::Gate::Awaiter::await_suspend(std::coroutine_handle<> h) {
+    std::lock_guard<std::mutex> lock(gate_.mutex_);
+    if (gate_.open_) return false;
+    gate_.waiters_.push_back(h);
+    return true;
+}
+
+std::vector<Scheduler::WorkerStats> Scheduler::workerStats() const {
+    std::vector<WorkerStats> out;
+    out.reserve(workers_.size());
+    for (auto &w : workers_) out.push_back({w.cpu, w.node, w.resumed.load(std::memory_order_relaxed)});
+    return out;
+}
+
+static Task runTask(std::function<void()> fn, std::promise<void> done) {
+    try {
+        fn();
+        done.set_value();
+    } catch (...) {
+        done.set_exception(std::current_exception());
+    }
+    co_return;
+}
+
+void Scheduler::runOnWorker(const std::function<void()> &fn) {
+    std::promise<void> done;
+    auto finished = done.get_future();
+    spawn(runTask(fn, std::move(done)));
+    finished.get();
+}
+
+void Scheduler::workerLoop(size_t index) {
+    Worker &self = workers_[index];
+    // The constructor already checked that the CPU is allowed.
+    if (self.cpu >= 0) pinCurrentThread(self.cpu);
+    traceThreadName("scheduler " + std::to_string(index));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        std::vector<TimerPtr> due;
+        auto now = Clock::now();
+        while (!timers_.empty() && timers_.top().deadline <= now) {
+            due.push_back(timers_.top().state);
+            timers_.pop();
+        }
+        if (!due.empty()) {
+            lock.unlock();
+            for (auto &state : due) fire(state);
+            lock.lock();
+            continue;
+        }
+
+        if (!ready_.empty()) {
+            auto h = ready_.front();
+            ready_.pop_front();
+            lock.unlock();
+            self.resumed.fetch_add(1, std::memory_order_relaxed);
+            h.resume();
+            lock.lock();
+            continue;
+        }
+
+        if (stopping_) break;
+
+        if (timers_.empty()) cv_.wait(lock);
+        else cv_.wait_until(lock, timers_.top().deadline);
+    }
+}
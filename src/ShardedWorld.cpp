@@ -0,0 +1,511 @@
+#include "ShardedWorld.h"
+#include "NPCFactory.h"
+#include "Editor.h"
+#include "LockstepRules.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+double ShardRegion::distanceTo(double x, double y) const {
+    double dx = std::max({x0 - x, 0.0, x - x1});
+    double dy = std::max({y0 - y, 0.0, y - y1});
+    return std::sqrt(dx*dx + dy*dy);
+}
+
+double ShardRegion::distanceToEdge(double x, double y) const {
+    return std::min({x - x0, x1 - x, y - y0, y1 - y});
+}
+
+ShardLayout::ShardLayout(int cols, int rows, double width, double height)
+    : cols_(cols), rows_(rows), width_(width), height_(height) {
+    if (cols <= 0 || rows <= 0 || width <= 0 || height <= 0)
+        throw std::invalid_argument("Invalid shard layout");
+}
+
+int ShardLayout::ownerOf(double x, double y) const {
+    int cx = std::clamp(static_cast<int>(x / width_ * cols_), 0, cols_ - 1);
+    int cy = std::clamp(static_cast<int>(y / height_ * rows_), 0, rows_ - 1);
+    return cy * cols_ + cx;
+}
+
+ShardRegion ShardLayout::region(int shard) const {
+    int cx = shard % cols_;
+    int cy = shard / cols_;
+    return {width_ * cx / cols_, height_ * cy / rows_,
+            width_ * (cx + 1) / cols_, height_ * (cy + 1) / rows_};
+}
+
+std::vector<int> ShardLayout::neighbours(int shard) const {
+    int cx = shard % cols_;
+    int cy = shard / cols_;
+    std::vector<int> out;
+    for (int y = std::max(cy - 1, 0); y <= std::min(cy + 1, rows_ - 1); ++y) {
+        for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, cols_ - 1); ++x) {
+            if (x != cx || y != cy) out.push_back(y * cols_ + x);
+        }
+    }
+    return out;
+}
+
+namespace {
+
+// Shards run the same binary on the same machine, so bodies travel as raw
+// bytes and arrive bit-identical.
+struct Body {
+    std::uint32_t id;
+    NPCType kind;
+    double x, y;
+};
+constexpr size_t BODY_BYTES = sizeof(std::uint32_t) + 1 + 2 * sizeof(double);
+
+struct KillRecord {
+    std::int32_t tick;
+    std::uint32_t killer, victim;
+};
+
+template <class T>
+void putRaw(std::string &out, const T &v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+}
+
+template <class T>
+T getRaw(const char *&p) {
+    T v;
+    std::memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return v;
+}
+
+void putBody(std::string &out, const Body &b) {
+    putRaw(out, b.id);
+    out.push_back(static_cast<char>(b.kind));
+    putRaw(out, b.x);
+    putRaw(out, b.y);
+}
+
+std::vector<Body> getBodies(const std::string &payload) {
+    if (payload.size() % BODY_BYTES != 0) throw std::runtime_error("Corrupt shard message");
+    std::vector<Body> bodies(payload.size() / BODY_BYTES);
+    const char *p = payload.data();
+    for (auto& b : bodies) {
+        b.id = getRaw<std::uint32_t>(p);
+        b.kind = static_cast<NPCType>(*p++);
+        b.x = getRaw<double>(p);
+        b.y = getRaw<double>(p);
+    }
+    return bodies;
+}
+
+void sendFrame(int fd, const std::string &payload) {
+    std::uint32_t len = static_cast<std::uint32_t>(payload.size());
+    std::string buf(reinterpret_cast<const char*>(&len), sizeof(len));
+    buf += payload;
+
+    size_t sent = 0;
+    while (sent < buf.size()) {
+        ssize_t n = ::send(fd, buf.data() + sent, buf.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Shard send failed: " + std::string(std::strerror(errno)));
+        sent += static_cast<size_t>(n);
+    }
+}
+
+void readExact(int fd, char *dst, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = ::read(fd, dst + got, len - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) throw std::runtime_error("Shard connection closed");
+        got += static_cast<size_t>(n);
+    }
+}
+
+std::string recvFrame(int fd) {
+    std::uint32_t len = 0;
+    readExact(fd, reinterpret_cast<char*>(&len), sizeof(len));
+    std::string payload(len, '\0');
+    readExact(fd, payload.data(), len);
+    return payload;
+}
+
+// Sends out[i] to fds[i] while receiving one frame from each fds[i]. Both
+// directions are driven by one poll loop, so two neighbours sending each
+// other more than a socket buffer cannot deadlock. Never reads past the
+// frame, so a neighbour that is already a phase ahead is left queued.
+std::vector<std::string> swapFrames(const std::vector<int> &fds, const std::vector<std::string> &out) {
+    struct Peer {
+        std::string out;
+        size_t sent = 0;
+        std::string in;
+        size_t need = sizeof(std::uint32_t);
+        bool sized = false;
+    };
+    std::vector<Peer> peers(fds.size());
+    for (size_t i = 0; i < fds.size(); ++i) {
+        putRaw(peers[i].out, static_cast<std::uint32_t>(out[i].size()));
+        peers[i].out += out[i];
+    }
+
+    std::vector<pollfd> pfds(fds.size());
+    while (true) {
+        size_t pending = 0;
+        for (size_t i = 0; i < fds.size(); ++i) {
+            const Peer &p = peers[i];
+            short events = 0;
+            if (p.sent < p.out.size()) events |= POLLOUT;
+            if (p.in.size() < p.need) events |= POLLIN;
+            pfds[i] = {events ? fds[i] : -1, events, 0};
+            if (events) ++pending;
+        }
+        if (pending == 0) break;
+        if (::poll(pfds.data(), pfds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            throw std::runtime_error("Shard poll failed: " + std::string(std::strerror(errno)));
+        }
+
+        for (size_t i = 0; i < fds.size(); ++i) {
+            Peer &p = peers[i];
+            short rev = pfds[i].revents;
+            if ((rev & POLLOUT) && p.sent < p.out.size()) {
+                ssize_t n = ::send(fds[i], p.out.data() + p.sent, p.out.size() - p.sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+                if (n < 0 && errno != EAGAIN && errno != EINTR)
+                    throw std::runtime_error("Shard send failed: " + std::string(std::strerror(errno)));
+                if (n > 0) p.sent += static_cast<size_t>(n);
+            }
+            if ((rev & (POLLIN | POLLHUP | POLLERR)) && p.in.size() < p.need) {
+                size_t have = p.in.size();
+                p.in.resize(p.need);
+                ssize_t n = ::recv(fds[i], p.in.data() + have, p.need - have, MSG_DONTWAIT);
+                p.in.resize(have + static_cast<size_t>(std::max<ssize_t>(n, 0)));
+                if (n == 0) throw std::runtime_error("Shard neighbour closed");
+                if (n < 0 && errno != EAGAIN && errno != EINTR)
+                    throw std::runtime_error("Shard receive failed: " + std::string(std::strerror(errno)));
+                if (!p.sized && p.in.size() == sizeof(std::uint32_t)) {
+                    std::uint32_t len;
+                    std::memcpy(&len, p.in.data(), sizeof(len));
+                    p.need += len;
+                    p.sized = true;
+                }
+            }
+        }
+    }
+
+    std::vector<std::string> in(fds.size());
+    for (size_t i = 0; i < fds.size(); ++i) in[i] = peers[i].in.substr(sizeof(std::uint32_t));
+    return in;
+}
+
+// Slack on the ghost zone, so a ghost is never dropped by rounding in
+// distanceTo that the battle's own range test would have kept.
+constexpr double GHOST_SLACK = 1e-6;
+
+// One region of the world, stepped tick by tick with the same LockstepRules
+// as Game's lockstep mode. Its Editor holds the NPCs it owns and, during a
+// battle, the ghosts its neighbours sent. `fds[i]` connects to shard
+// `neighbours[i]`; a single shard covering the map has none.
+class Shard {
+    int id_;
+    ShardLayout layout_;
+    ShardOptions opts_;
+    LockstepRules rules_;
+    // The NPCs passed to run(), for the names behind the body ids.
+    const std::vector<NPCPtr> &npcs_;
+    std::vector<int> neighbours_;
+    std::vector<int> fds_;
+    Editor world_;
+    // Body id of each NPC id of world_.
+    std::vector<std::uint32_t> body_of_;
+    // Per handle index: the NPC there is a ghost.
+    std::vector<char> ghost_;
+    std::vector<KillRecord> kills_;
+    std::uint64_t migrations_ = 0;
+
+    NPCHandle add(const Body &b) {
+        const std::string &name = npcs_[b.id]->name();
+        if (!world_.addNPC(NPCFactory::create(b.kind, name, b.x, b.y)))
+            throw std::runtime_error("NPC outside the shard's world: " + name);
+        NPCId id = world_.names().find(name);
+        if (id >= body_of_.size()) body_of_.resize(id + 1);
+        body_of_[id] = b.id;
+        return world_.handleOf(id);
+    }
+
+    Body bodyOf(NPCHandle h) const {
+        NPCPtr npc = world_.find(h);
+        return {body_of_[world_.idOf(h)], npc->kind(), npc->x(), npc->y()};
+    }
+
+    void migrate() {
+        std::vector<std::string> out(neighbours_.size());
+        std::vector<NPCHandle> leaving;
+        const auto &npcs = world_.npcs();
+        const auto &handles = world_.handles();
+        for (size_t i = 0; i < npcs.size(); ++i) {
+            int owner = layout_.ownerOf(npcs[i]->x(), npcs[i]->y());
+            if (owner == id_) continue;
+            auto it = std::find(neighbours_.begin(), neighbours_.end(), owner);
+            if (it == neighbours_.end()) throw std::logic_error("NPC moved past the neighbouring shards");
+            putBody(out[static_cast<size_t>(it - neighbours_.begin())], bodyOf(handles[i]));
+            leaving.push_back(handles[i]);
+        }
+        for (NPCHandle h : leaving) world_.kill(h);
+        world_.compact();
+        migrations_ += leaving.size();
+
+        for (const auto& payload : swapFrames(fds_, out)) {
+            for (const auto& b : getBodies(payload)) add(b);
+        }
+    }
+
+    // Adds the neighbours' NPCs within kill distance of this region.
+    std::vector<NPCHandle> addGhosts() {
+        std::vector<std::string> out(neighbours_.size());
+        const auto &npcs = world_.npcs();
+        const auto &handles = world_.handles();
+        for (size_t i = 0; i < neighbours_.size(); ++i) {
+            ShardRegion region = layout_.region(neighbours_[i]);
+            for (size_t j = 0; j < npcs.size(); ++j) {
+                if (region.distanceTo(npcs[j]->x(), npcs[j]->y()) <= opts_.kill_distance + GHOST_SLACK)
+                    putBody(out[i], bodyOf(handles[j]));
+            }
+        }
+        std::vector<NPCHandle> ghosts;
+        for (const auto& payload : swapFrames(fds_, out)) {
+            for (const auto& b : getBodies(payload)) {
+                NPCHandle h = add(b);
+                if (h.index >= ghost_.size()) ghost_.resize(h.index + 1, 0);
+                ghost_[h.index] = 1;
+                ghosts.push_back(h);
+            }
+        }
+        return ghosts;
+    }
+
+    // Ghosts attack the NPCs this shard owns but are not attacked here: the
+    // shard that owns them decides their fate from the same positions.
+    void battle(int tick, const std::vector<NPCHandle> &ghosts) {
+        auto owned = [&](NPCHandle h) { return h.index >= ghost_.size() || !ghost_[h.index]; };
+        auto kills = rules_.battle(world_, tick, owned);
+        for (const auto& k : kills)
+            kills_.push_back({tick, bodyOf(k.killer).id, bodyOf(k.victim).id});
+        for (const auto& k : kills) world_.kill(k.victim);
+        for (NPCHandle h : ghosts) {
+            ghost_[h.index] = 0;
+            world_.kill(h);
+        }
+        world_.compact();
+    }
+
+public:
+    Shard(int id, ShardLayout layout, ShardOptions opts, const std::vector<NPCPtr> &npcs,
+          std::vector<int> neighbours, std::vector<int> fds, const std::vector<Body> &owned)
+        : id_(id), layout_(layout), opts_(opts),
+          rules_({.seed = opts.seed, .move_distance = opts.move_distance, .kill_distance = opts.kill_distance,
+                  .width = layout.width(), .height = layout.height()}),
+          npcs_(npcs), neighbours_(std::move(neighbours)), fds_(std::move(fds)) {
+        for (const auto& b : owned) add(b);
+    }
+
+    void step(int tick) {
+        rules_.move(world_, tick);
+        migrate();
+        battle(tick, addGhosts());
+    }
+
+    std::vector<Body> owned() const {
+        std::vector<Body> bodies;
+        for (NPCHandle h : world_.handles()) bodies.push_back(bodyOf(h));
+        return bodies;
+    }
+    const std::vector<KillRecord>& kills() const { return kills_; }
+    std::uint64_t migrations() const { return migrations_; }
+};
+
+std::vector<Body> bodiesOf(const std::vector<NPCPtr> &npcs) {
+    std::vector<Body> bodies;
+    bodies.reserve(npcs.size());
+    for (size_t i = 0; i < npcs.size(); ++i)
+        bodies.push_back({static_cast<std::uint32_t>(i), npcs[i]->kind(), npcs[i]->x(), npcs[i]->y()});
+    return bodies;
+}
+
+// Turns the shards' survivors and kills back into named NPCs.
+ShardRunResult collect(const std::vector<NPCPtr> &npcs, std::vector<Body> survivors,
+                       std::vector<KillRecord> kills, std::uint64_t migrations) {
+    std::sort(survivors.begin(), survivors.end(), [](const Body &a, const Body &b) { return a.id < b.id; });
+    // A victim dies once, so tick and victim name give the order Game's
+    // lockstep mode reports its rounds in.
+    std::sort(kills.begin(), kills.end(), [&](const KillRecord &a, const KillRecord &b) {
+        return std::tie(a.tick, npcs[a.victim]->name()) < std::tie(b.tick, npcs[b.victim]->name());
+    });
+
+    ShardRunResult result;
+    result.migrations = migrations;
+    for (const auto& b : survivors)
+        result.survivors.push_back(NPCFactory::create(b.kind, npcs[b.id]->name(), b.x, b.y));
+    for (const auto& k : kills)
+        result.kills.push_back({k.tick, npcs[k.killer]->name(), npcs[k.victim]->name()});
+    return result;
+}
+
+void runShard(int control, Shard &shard, int ticks) {
+    for (int t = 1; t <= ticks; ++t) shard.step(t);
+
+    std::string survivors;
+    for (const auto& b : shard.owned()) putBody(survivors, b);
+    std::string kills;
+    for (const auto& k : shard.kills()) putRaw(kills, k);
+    std::string migrations;
+    putRaw(migrations, shard.migrations());
+    sendFrame(control, survivors);
+    sendFrame(control, kills);
+    sendFrame(control, migrations);
+}
+
+} // namespace
+
+ShardedWorld::ShardedWorld(ShardLayout layout, ShardOptions opts) : layout_(layout), opts_(opts) {
+    ShardRegion r = layout_.region(0);
+    double reach = std::max(opts_.move_distance, opts_.kill_distance);
+    if (opts_.ticks < 0 || r.x1 - r.x0 <= reach || r.y1 - r.y0 <= reach)
+        throw std::invalid_argument("Shard regions must be larger than the move and kill distances");
+}
+
+ShardRunResult ShardedWorld::runInProcess(const std::vector<NPCPtr> &npcs) const {
+    Shard shard(0, ShardLayout(1, 1, layout_.width(), layout_.height()), opts_, npcs, {}, {}, bodiesOf(npcs));
+    for (int t = 1; t <= opts_.ticks; ++t) shard.step(t);
+    return collect(npcs, shard.owned(), shard.kills(), shard.migrations());
+}
+
+ShardRunResult ShardedWorld::run(const std::vector<NPCPtr> &npcs) const {
+    const int n = layout_.count();
+    std::vector<std::vector<Body>> owned(n);
+    for (const auto& b : bodiesOf(npcs))
+        owned[layout_.ownerOf(b.x, b.y)].push_back(b);
+
+    // One socket pair per pair of neighbouring shards, created before any
+    // fork so every shard inherits the ends it needs.
+    std::map<std::pair<int, int>, std::array<int, 2>> links;
+    std::vector<int> controls;
+    std::vector<pid_t> pids;
+    auto closeLinks = [&]() {
+        for (auto& [key, fds] : links) {
+            ::close(fds[0]);
+            ::close(fds[1]);
+        }
+        links.clear();
+    };
+    auto cleanup = [&]() {
+        closeLinks();
+        for (int fd : controls) ::close(fd);
+        controls.clear();
+        bool ok = true;
+        for (pid_t pid : pids) {
+            int status = 0;
+            while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+            ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+        pids.clear();
+        return ok;
+    };
+
+    std::vector<Body> survivors;
+    std::vector<KillRecord> kills;
+    std::uint64_t migrations = 0;
+    try {
+        for (int s = 0; s < n; ++s) {
+            for (int other : layout_.neighbours(s)) {
+                if (other < s) continue;
+                std::array<int, 2> fds;
+                if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) != 0)
+                    throw std::runtime_error("socketpair failed");
+                links[{s, other}] = fds;
+            }
+        }
+
+        for (int s = 0; s < n; ++s) {
+            int pair[2];
+            if (::socketpair(AF_UNIX, SOCK_STREAM, 0, pair) != 0)
+                throw std::runtime_error("socketpair failed");
+
+            pid_t pid = ::fork();
+            if (pid < 0) {
+                ::close(pair[0]);
+                ::close(pair[1]);
+                throw std::runtime_error("fork failed");
+            }
+            if (pid == 0) {
+                for (int fd : controls) ::close(fd);
+                ::close(pair[0]);
+                std::vector<int> neighbours, fds;
+                for (auto& [key, ends] : links) {
+                    if (key.first == s) {
+                        neighbours.push_back(key.second);
+                        fds.push_back(ends[0]);
+                        ::close(ends[1]);
+                    } else if (key.second == s) {
+                        neighbours.push_back(key.first);
+                        fds.push_back(ends[1]);
+                        ::close(ends[0]);
+                    } else {
+                        ::close(ends[0]);
+                        ::close(ends[1]);
+                    }
+                }
+                int code = 0;
+                try {
+                    Shard shard(s, layout_, opts_, npcs, std::move(neighbours), std::move(fds),
+                                getBodies(recvFrame(pair[1])));
+                    runShard(pair[1], shard, opts_.ticks);
+                } catch (...) {
+                    code = 1;
+                }
+                ::_exit(code);
+            }
+            ::close(pair[1]);
+            controls.push_back(pair[0]);
+            pids.push_back(pid);
+        }
+        // Only the shards talk to each other; holding the links here would
+        // keep a shard from noticing that its neighbour died.
+        closeLinks();
+
+        for (int s = 0; s < n; ++s) {
+            std::string payload;
+            for (const auto& b : owned[s]) putBody(payload, b);
+            sendFrame(controls[s], payload);
+        }
+
+        for (int s = 0; s < n; ++s) {
+            auto part = getBodies(recvFrame(controls[s]));
+            survivors.insert(survivors.end(), part.begin(), part.end());
+
+            std::string records = recvFrame(controls[s]);
+            if (records.size() % sizeof(KillRecord) != 0) throw std::runtime_error("Corrupt shard message");
+            const char *p = records.data();
+            for (size_t i = 0; i < records.size() / sizeof(KillRecord); ++i)
+                kills.push_back(getRaw<KillRecord>(p));
+
+            std::string count = recvFrame(controls[s]);
+            if (count.size() != sizeof(migrations)) throw std::runtime_error("Corrupt shard message");
+            p = count.data();
+            migrations += getRaw<std::uint64_t>(p);
+        }
+    } catch (...) {
+        cleanup();
+        throw;
+    }
+    if (!cleanup()) throw std::runtime_error("Shard process failed");
+
+    return collect(npcs, std::move(survivors), std::move(kills), migrations);
+}
@@ -0,0 +1,115 @@
+#include "SnapshotBuilder.h"
+#include <algorithm>
+#include <atomic>
+
+SnapshotBuilder::SnapshotBuilder() : current_(std::make_shared<WorldSnapshot>()) {}
+
+void SnapshotBuilder::reset(const Editor &editor) {
+    auto snap = std::make_shared<WorldSnapshot>();
+    snap->npcs.reserve(editor.size());
+    snap->ids.reserve(editor.size());
+    snap->handles.reserve(editor.size());
+    order_.clear();
+    const auto &npcs = editor.npcs();
+    const auto &handles = editor.handles();
+    for (size_t i = 0; i < npcs.size(); ++i) {
+        if (!npcs[i]) continue;
+        SlotHandle h = handles[i];
+        if (h.index >= pos_.size()) pos_.resize(h.index + 1);
+        pos_[h.index] = static_cast<std::uint32_t>(order_.size());
+        order_.push_back(h);
+        snap->npcs.push_back(npcs[i]);
+        snap->ids.push_back(editor.idOf(h));
+        snap->handles.push_back(h);
+    }
+
+    ops_.clear();
+    spares_.clear();
+    staged_ = std::move(snap);
+}
+
+void SnapshotBuilder::moved(SlotHandle h, NPCPtr npc) {
+    ops_.push_back({Op::Set, pos_[h.index], current_->version + 1, std::move(npc)});
+}
+
+void SnapshotBuilder::removed(SlotHandle h) {
+    std::uint32_t p = pos_[h.index];
+    order_[p] = order_.back();
+    pos_[order_[p].index] = p;
+    order_.pop_back();
+    ops_.push_back({Op::Remove, p, current_->version + 1, nullptr});
+}
+
+void SnapshotBuilder::apply(WorldSnapshot &snap, const Op &op) {
+    if (op.kind == Op::Set) {
+        snap.npcs[op.pos] = op.npc;
+        return;
+    }
+    snap.npcs[op.pos] = std::move(snap.npcs.back());
+    snap.ids[op.pos] = snap.ids.back();
+    snap.handles[op.pos] = snap.handles.back();
+    snap.npcs.pop_back();
+    snap.ids.pop_back();
+    snap.handles.pop_back();
+}
+
+std::shared_ptr<WorldSnapshot> SnapshotBuilder::build() {
+    const std::uint64_t version = current_->version + 1;
+    std::shared_ptr<WorldSnapshot> next;
+
+    if (staged_) {
+        // Everything before the reset is gone; later changes still apply.
+        next = std::move(staged_);
+        next->version = current_->version;
+        floor_ = version;
+    } else {
+        // The freshest spare no reader holds. use_count() == 1 means only
+        // this builder still owns it.
+        auto best = spares_.end();
+        for (auto it = spares_.begin(); it != spares_.end(); ++it) {
+            if (it->use_count() != 1) continue;
+            if (best == spares_.end() || (*it)->version > (*best)->version) best = it;
+        }
+        if (best != spares_.end()) {
+            // Pairs with the release in the last reader's shared_ptr destructor.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            next = std::move(*best);
+            spares_.erase(best);
+        }
+        if (!next || next->version < floor_) {
+            // Nothing to catch up from: copy the latest snapshot, reusing the
+            // spare's storage if there is one.
+            if (next) *next = *current_;
+            else next = std::make_shared<WorldSnapshot>(*current_);
+            ++full_copies_;
+        }
+    }
+
+    auto first = std::partition_point(ops_.begin(), ops_.end(),
+                                      [&](const Op &op) { return op.version <= next->version; });
+    for (auto it = first; it != ops_.end(); ++it) apply(*next, *it);
+    next->version = version;
+
+    spares_.push_back(std::move(current_));
+    current_ = next;
+    if (spares_.size() > MAX_SPARES) {
+        auto oldest = std::min_element(spares_.begin(), spares_.end(),
+                                       [](const auto &a, const auto &b) { return a->version < b->version; });
+        spares_.erase(oldest);
+    }
+    trim();
+    return next;
+}
+
+void SnapshotBuilder::trim() {
+    // Changes every spare already has are no longer needed.
+    std::uint64_t keep_after = current_->version;
+    for (const auto &s : spares_) {
+        if (s->version >= floor_) keep_after = std::min(keep_after, s->version);
+    }
+    const size_t cap = std::max(MIN_KEPT_OPS, 2 * order_.size());
+    while (!ops_.empty() && (ops_.front().version <= keep_after || ops_.size() > cap)) {
+        floor_ = std::max(floor_, ops_.front().version);
+        ops_.pop_front();
+    }
+}
@@ -0,0 +1,68 @@
+#include "SpatialGrid.h"
+#include <cmath>
+#include <stdexcept>
+
+SpatialGrid::SpatialGrid(double width, double height, double cell)
+    : cell_(cell) {
+    if (width <= 0 || height <= 0 || cell <= 0)
+        throw std::invalid_argument("Invalid spatial grid");
+
+    cols_ = std::max(1, static_cast<int>(std::ceil(width / cell)));
+    rows_ = std::max(1, static_cast<int>(std::ceil(height / cell)));
+    cells_.resize(static_cast<std::size_t>(cols_) * rows_);
+}
+
+void SpatialGrid::insert(SlotHandle h, double x, double y) {
+    if (h.index >= where_.size())
+        where_.resize(h.index + 1);
+    if (where_[h.index].cell != NO_CELL) {
+        unlink(where_[h.index]);
+        --size_;
+    }
+
+    std::uint32_t cell = cellOf(x, y);
+    where_[h.index] = {cell, static_cast<std::uint32_t>(cells_[cell].size())};
+    cells_[cell].push_back({h, x, y});
+    ++size_;
+}
+
+void SpatialGrid::move(SlotHandle h, double x, double y) {
+    if (!contains(h)) return;
+
+    Locator &l = where_[h.index];
+    std::uint32_t cell = cellOf(x, y);
+    if (cell == l.cell) {
+        Entry &e = cells_[cell][l.pos];
+        e.x = x;
+        e.y = y;
+        return;
+    }
+
+    unlink(l);
+    l = {cell, static_cast<std::uint32_t>(cells_[cell].size())};
+    cells_[cell].push_back({h, x, y});
+}
+
+void SpatialGrid::erase(SlotHandle h) {
+    if (!contains(h)) return;
+
+    unlink(where_[h.index]);
+    where_[h.index] = {};
+    --size_;
+}
+
+// Removes the entry at `l` by swapping the cell's last entry into its place.
+void SpatialGrid::unlink(const Locator &l) {
+    auto &bucket = cells_[l.cell];
+    if (l.pos + 1 != bucket.size()) {
+        bucket[l.pos] = bucket.back();
+        where_[bucket[l.pos].handle.index].pos = l.pos;
+    }
+    bucket.pop_back();
+}
+
+void SpatialGrid::clear() {
+    for (auto &bucket : cells_) bucket.clear();
+    where_.clear();
+    size_ = 0;
+}
@@ -0,0 +1,241 @@
+#include "Trace.h"
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+std::atomic<bool> g_trace_enabled{false};
+
+namespace {
+
+struct TraceEvent {
+    const char *name;
+    std::uint64_t start_ns;
+    std::uint64_t end_ns;
+};
+
+// A ring entry. Atomic so an exporter may copy it while the owner writes;
+// relaxed stores compile to plain ones.
+struct TraceSlot {
+    std::atomic<const char*> name{nullptr};
+    std::atomic<std::uint64_t> start_ns{0};
+    std::atomic<std::uint64_t> end_ns{0};
+};
+
+// One writer (the owning thread), any number of exporters. `head` counts
+// the events ever written; only its owner stores to it. traceClear moves
+// `cleared` up to it instead, so clearing never races with the owner.
+struct ThreadTrace {
+    std::uint32_t tid = 0;
+    std::string name;  // guarded by the registry mutex
+    bool exited = false;  // guarded by the registry mutex
+    std::unique_ptr<TraceSlot[]> events{new TraceSlot[TRACE_RING_CAPACITY]};
+    std::atomic<std::uint64_t> head{0};
+    std::atomic<std::uint64_t> cleared{0};
+
+    // First index still held, given a head loaded before.
+    std::uint64_t first(std::uint64_t h) const {
+        std::uint64_t oldest = h > TRACE_RING_CAPACITY ? h - TRACE_RING_CAPACITY : 0;
+        return std::max(oldest, std::min(cleared.load(std::memory_order_acquire), h));
+    }
+};
+
+// Rings of exited threads kept for export. Past this the oldest is handed
+// to the next new thread, so a process that keeps starting threads holds a
+// bounded number of rings.
+constexpr size_t MAX_EXITED_TRACES = 16;
+
+struct Registry {
+    std::mutex mutex;
+    // Live threads' rings, then exited ones until they are exported,
+    // cleared or recycled.
+    std::vector<std::shared_ptr<ThreadTrace>> threads;
+    // Rings no thread uses and no export needs, ready for reuse.
+    std::vector<std::shared_ptr<ThreadTrace>> spare;
+    std::uint32_t next_tid = 1;
+};
+
+Registry& registry() {
+    static Registry r;
+    return r;
+}
+
+// Moves exited threads' rings to the spare list. Caller holds the mutex.
+void recycleExited(Registry &r, size_t keep) {
+    size_t exited = 0;
+    for (auto &t : r.threads) exited += t->exited;
+    auto it = r.threads.begin();
+    while (exited > keep && it != r.threads.end()) {
+        if (!(*it)->exited) {
+            ++it;
+            continue;
+        }
+        r.spare.push_back(std::move(*it));
+        it = r.threads.erase(it);
+        --exited;
+    }
+}
+
+// Hands the calling thread's ring back to the registry when it exits.
+struct LocalTrace {
+    std::shared_ptr<ThreadTrace> trace;
+    ~LocalTrace() {
+        if (!trace) return;
+        auto &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        trace->exited = true;
+        recycleExited(r, MAX_EXITED_TRACES);
+    }
+};
+
+thread_local LocalTrace t_local;
+thread_local std::string t_name;
+
+// Threads get a buffer on their first event only, so naming a thread or
+// running with tracing off allocates nothing.
+ThreadTrace& localTrace() {
+    if (!t_local.trace) {
+        auto &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        std::shared_ptr<ThreadTrace> t;
+        if (!r.spare.empty()) {
+            // The previous owner has exited, so nothing writes to it.
+            t = std::move(r.spare.back());
+            r.spare.pop_back();
+            t->exited = false;
+            t->cleared.store(t->head.load(std::memory_order_relaxed), std::memory_order_release);
+        } else {
+            t = std::make_shared<ThreadTrace>();
+        }
+        t->tid = r.next_tid++;
+        t->name = t_name;
+        r.threads.push_back(t);
+        t_local.trace = std::move(t);
+    }
+    return *t_local.trace;
+}
+
+// Events of `t` still in its ring, oldest first. The ring is copied up to
+// its published head; entries the owner overwrote meanwhile are dropped.
+std::vector<TraceEvent> copyRing(const ThreadTrace &t) {
+    std::uint64_t head = t.head.load(std::memory_order_acquire);
+    std::uint64_t begin = t.first(head);
+    std::vector<TraceEvent> out;
+    out.reserve(static_cast<size_t>(head - begin));
+    for (std::uint64_t i = begin; i < head; ++i) {
+        const TraceSlot &e = t.events[i % TRACE_RING_CAPACITY];
+        out.push_back({e.name.load(std::memory_order_relaxed), e.start_ns.load(std::memory_order_relaxed),
+                       e.end_ns.load(std::memory_order_relaxed)});
+    }
+    // Slot i is reused by event i + capacity, which the owner may already be
+    // writing once head has reached i + capacity.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    std::uint64_t now = t.head.load(std::memory_order_relaxed);
+    std::uint64_t valid = now >= TRACE_RING_CAPACITY ? now - TRACE_RING_CAPACITY + 1 : 0;
+    if (valid > begin) out.erase(out.begin(), out.begin() + static_cast<std::ptrdiff_t>(std::min(valid, head) - begin));
+    return out;
+}
+
+const auto trace_epoch = std::chrono::steady_clock::now();
+
+void writeJsonString(std::ostream &out, const std::string &s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20) out << ' ';
+        else out << c;
+    }
+    out << '"';
+}
+
+} // namespace
+
+void traceEnable(bool on) {
+    g_trace_enabled.store(on, std::memory_order_relaxed);
+}
+
+void traceClear() {
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (auto &t : r.threads) t->cleared.store(t->head.load(std::memory_order_acquire), std::memory_order_release);
+    recycleExited(r, 0);
+}
+
+void traceThreadName(const std::string &name) {
+    t_name = name;
+    if (!t_local.trace) return;
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    t_local.trace->name = name;
+}
+
+size_t traceEventCount() {
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    size_t n = 0;
+    for (auto &t : r.threads) {
+        std::uint64_t head = t->head.load(std::memory_order_acquire);
+        n += static_cast<size_t>(head - t->first(head));
+    }
+    return n;
+}
+
+size_t traceBufferCount() {
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    return r.threads.size() + r.spare.size();
+}
+
+std::uint64_t traceNowNs() {
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_epoch).count());
+}
+
+void traceRecord(const char *name, std::uint64_t start_ns, std::uint64_t end_ns) {
+    ThreadTrace &t = localTrace();
+    std::uint64_t i = t.head.load(std::memory_order_relaxed);
+    TraceSlot &e = t.events[i % TRACE_RING_CAPACITY];
+    e.name.store(name, std::memory_order_relaxed);
+    e.start_ns.store(start_ns, std::memory_order_relaxed);
+    e.end_ns.store(end_ns, std::memory_order_relaxed);
+    t.head.store(i + 1, std::memory_order_release);
+}
+
+void writeChromeTrace(const std::string &path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) throw std::runtime_error("Cannot open trace file: " + path);
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    auto sep = [&] {
+        if (!first) out << ",\n";
+        first = false;
+    };
+
+    auto &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    out << std::fixed << std::setprecision(3);
+    for (auto &t : r.threads) {
+        if (!t->name.empty()) {
+            sep();
+            out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << t->tid << ",\"args\":{\"name\":";
+            writeJsonString(out, t->name);
+            out << "}}";
+        }
+
+        for (const TraceEvent &e : copyRing(*t)) {
+            sep();
+            out << "{\"ph\":\"X\",\"cat\":\"lab7\",\"name\":";
+            writeJsonString(out, e.name);
+            out << ",\"pid\":1,\"tid\":" << t->tid
+                << ",\"ts\":" << static_cast<double>(e.start_ns) / 1000.0
+                << ",\"dur\":" << static_cast<double>(e.end_ns - e.start_ns) / 1000.0 << '}';
+        }
+    }
+    // Exited threads' events are in the file now; their rings can go.
+    recycleExited(r, 0);
+    out << "]}\n";
+    if (!out) throw std::runtime_error("Failed to write trace file: " + path);
+}
@@ -0,0 +1,236 @@
+#include "Trajectory.h"
+#include "Varint.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+static constexpr char TRAJECTORY_MAGIC[4] = {'L', '7', 'T', 'R'};
+static constexpr char TRAJECTORY_VERSION = 1;
+
+static std::int64_t quantize(double v) {
+    return static_cast<std::int64_t>(std::llround(v * 100.0));
+}
+
+TrajectoryRecorder::TrajectoryRecorder(const std::string &path, TrajectoryOptions opts)
+    : path_(path), out_(path, std::ios::binary | std::ios::trunc), opts_(opts) {
+    if (!out_) throw std::runtime_error("Cannot open trajectory file: " + path);
+    if (opts_.ticks_per_group == 0) opts_.ticks_per_group = 1;
+
+    out_.write(TRAJECTORY_MAGIC, sizeof(TRAJECTORY_MAGIC));
+    out_.put(TRAJECTORY_VERSION);
+    group_no_ = 1;
+    writer_ = std::thread([this] { run(); });
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+    close();
+}
+
+bool TrajectoryRecorder::record(SnapshotPtr snap) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (closing_ || queue_.size() >= opts_.max_queued) {
+            ++dropped_;
+            return false;
+        }
+        queue_.push_back(std::move(snap));
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void TrajectoryRecorder::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = true;
+    }
+    cv_.notify_one();
+    if (writer_.joinable()) writer_.join();
+    if (out_.is_open()) out_.close();
+}
+
+void TrajectoryRecorder::reopen() {
+    if (writer_.joinable()) return;
+    // Row groups are self-contained, so a later run just adds more of them.
+    out_.open(path_, std::ios::binary | std::ios::app);
+    if (!out_) throw std::runtime_error("Cannot reopen trajectory file: " + path_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing_ = false;
+    }
+    writer_ = std::thread([this] { run(); });
+}
+
+void TrajectoryRecorder::run() {
+    while (true) {
+        SnapshotPtr snap;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return closing_ || !queue_.empty(); });
+            if (queue_.empty()) break;
+            snap = std::move(queue_.front());
+            queue_.pop_front();
+        }
+
+        encode(*snap);
+        ++recorded_;
+        if (group_.ticks >= opts_.ticks_per_group) writeGroup();
+    }
+
+    writeGroup();
+    out_.flush();
+}
+
+void TrajectoryRecorder::encode(const WorldSnapshot &snap) {
+    putVarint(group_.tick, zigzag(static_cast<std::int64_t>(snap.version - last_tick_)));
+    last_tick_ = snap.version;
+    putVarint(group_.count, snap.npcs.size());
+
+    std::int64_t prev_id = 0;
+    for (size_t i = 0; i < snap.npcs.size(); ++i) {
+        const NPC &npc = *snap.npcs[i];
+        NPCId id = snap.ids[i];
+        if (id >= last_.size()) last_.resize(id + 1);
+
+        Last &last = last_[id];
+        if (last.group != group_no_) {
+            last = {group_no_, 0, 0};
+            putVarint(group_.names, id);
+            putVarint(group_.names, npc.name().size());
+            group_.names += npc.name();
+        }
+
+        putVarint(group_.id, zigzag(static_cast<std::int64_t>(id) - prev_id));
+        prev_id = id;
+        group_.kind.push_back(static_cast<char>(npc.kind()));
+
+        std::int64_t qx = quantize(npc.x());
+        std::int64_t qy = quantize(npc.y());
+        putVarint(group_.x, zigzag(qx - last.x));
+        putVarint(group_.y, zigzag(qy - last.y));
+        last.x = qx;
+        last.y = qy;
+    }
+
+    ++group_.ticks;
+    group_.rows += snap.npcs.size();
+}
+
+void TrajectoryRecorder::writeGroup() {
+    if (group_.ticks == 0) return;
+
+    std::string body;
+    putVarint(body, group_.ticks);
+    putVarint(body, group_.rows);
+    for (const std::string *column : {&group_.tick, &group_.count, &group_.names, &group_.id,
+                                      &group_.kind, &group_.x, &group_.y}) {
+        putVarint(body, column->size());
+        body += *column;
+    }
+
+    std::string frame;
+    putVarint(frame, body.size());
+    out_.write(frame.data(), static_cast<std::streamsize>(frame.size()));
+    out_.write(body.data(), static_cast<std::streamsize>(body.size()));
+    out_.flush();
+
+    group_ = {};
+    last_tick_ = 0;
+    ++group_no_;
+}
+
+TrajectoryReader::TrajectoryReader(const std::string &path)
+    : in_(path, std::ios::binary) {
+    char header[sizeof(TRAJECTORY_MAGIC) + 1];
+    if (!in_.read(header, sizeof(header)) ||
+        !std::equal(TRAJECTORY_MAGIC, TRAJECTORY_MAGIC + sizeof(TRAJECTORY_MAGIC), header))
+        throw std::runtime_error("Not a trajectory file: " + path);
+    if (header[sizeof(TRAJECTORY_MAGIC)] != TRAJECTORY_VERSION)
+        throw std::runtime_error("Unsupported trajectory version: " + path);
+}
+
+bool TrajectoryReader::readGroup() {
+    group_.clear();
+    next_ = 0;
+
+    std::uint64_t size = 0;
+    for (int shift = 0;; shift += 7) {
+        int c = in_.get();
+        if (c == EOF || shift >= 64) return false;
+        size |= static_cast<std::uint64_t>(c & 0x7f) << shift;
+        if (!(c & 0x80)) break;
+    }
+
+    std::string body(size, '\0');
+    if (!in_.read(body.data(), static_cast<std::streamsize>(size))) return false;
+
+    const char *p = body.data();
+    const char *end = p + body.size();
+    std::uint64_t ticks, rows;
+    if (!getVarint(p, end, ticks) || !getVarint(p, end, rows)) return false;
+
+    // Column order as written by TrajectoryRecorder::writeGroup.
+    enum { TICK, COUNT, NAMES, ID, KIND, X, Y, COLUMNS };
+    const char *col[COLUMNS];
+    const char *col_end[COLUMNS];
+    for (int c = 0; c < COLUMNS; ++c) {
+        std::uint64_t len;
+        if (!getVarint(p, end, len) || len > static_cast<std::uint64_t>(end - p)) return false;
+        col[c] = p;
+        col_end[c] = p + len;
+        p += len;
+    }
+    if (static_cast<std::uint64_t>(col_end[KIND] - col[KIND]) != rows) return false;
+
+    std::unordered_map<NPCId, std::pair<std::int64_t, std::int64_t>> last;
+    while (col[NAMES] < col_end[NAMES]) {
+        std::uint64_t id, len;
+        if (!getVarint(col[NAMES], col_end[NAMES], id) || !getVarint(col[NAMES], col_end[NAMES], len) ||
+            len > static_cast<std::uint64_t>(col_end[NAMES] - col[NAMES]))
+            return false;
+        names_[static_cast<NPCId>(id)].assign(col[NAMES], len);
+        col[NAMES] += len;
+    }
+
+    std::vector<TrajectoryTick> group(ticks);
+    std::uint64_t tick = 0;
+    for (auto &t : group) {
+        std::uint64_t delta, count;
+        if (!getVarint(col[TICK], col_end[TICK], delta) || !getVarint(col[COUNT], col_end[COUNT], count))
+            return false;
+        tick += static_cast<std::uint64_t>(unzigzag(delta));
+        t.tick = tick;
+        t.rows.resize(count);
+
+        std::int64_t id = 0;
+        for (auto &row : t.rows) {
+            std::uint64_t did, dx, dy;
+            if (!getVarint(col[ID], col_end[ID], did) || col[KIND] >= col_end[KIND] ||
+                !getVarint(col[X], col_end[X], dx) || !getVarint(col[Y], col_end[Y], dy))
+                return false;
+            id += unzigzag(did);
+            auto &pos = last[static_cast<NPCId>(id)];
+            pos.first += unzigzag(dx);
+            pos.second += unzigzag(dy);
+
+            row.id = static_cast<NPCId>(id);
+            row.kind = static_cast<NPCType>(*col[KIND]++);
+            row.x = static_cast<double>(pos.first) / 100.0;
+            row.y = static_cast<double>(pos.second) / 100.0;
+        }
+    }
+    group_ = std::move(group);
+    return true;
+}
+
+bool TrajectoryReader::next(TrajectoryTick &tick) {
+    if (next_ >= group_.size() && !readGroup()) return false;
+    if (group_.empty()) return false;
+    tick = std::move(group_[next_++]);
+    return true;
+}
+
+std::string_view TrajectoryReader::name(NPCId id) const {
+    auto it = names_.find(id);
+    return it == names_.end() ? std::string_view{} : std::string_view(it->second);
+}
@@ -0,0 +1,112 @@
+#include "VariantWorld.h"
+#include "KillMatrix.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+VariantWorld::VariantWorld(const std::vector<NPCPtr> &npcs) {
+    npcs_.reserve(npcs.size());
+    for (auto &n : npcs)
+        add(*n);
+}
+
+void VariantWorld::addObserver(ObsPtr obs) {
+    observers_.push_back(obs);
+}
+
+void VariantWorld::add(const NPC &npc) {
+    switch (npc.kind()) {
+        case NPCType::Bear:    npcs_.emplace_back(static_cast<const Bear&>(npc)); break;
+        case NPCType::Bittern: npcs_.emplace_back(static_cast<const Bittern&>(npc)); break;
+        case NPCType::Desman:  npcs_.emplace_back(static_cast<const Desman&>(npc)); break;
+    }
+}
+
+std::vector<NPCPtr> VariantWorld::toNPCs() const {
+    std::vector<NPCPtr> out;
+    out.reserve(npcs_.size());
+    for (auto &v : npcs_) {
+        out.push_back(std::visit([](const auto &n) -> NPCPtr {
+            return std::make_shared<std::decay_t<decltype(n)>>(n);
+        }, v));
+    }
+    return out;
+}
+
+// Single pass, for the reason given at Editor::runBattle.
+void VariantWorld::runBattle(double distance) {
+    StaticFightRules rules;
+    const KillMatrix &matrix = KillMatrix::standard();
+    double d2 = distance * distance;
+
+    std::array<std::vector<uint32_t>, NPC_TYPE_COUNT> species;
+    std::array<SpeciesBounds, NPC_TYPE_COUNT> bounds;
+    std::array<int, NPC_TYPE_COUNT> counts{};
+    for (uint32_t i = 0; i < npcs_.size(); ++i) {
+        size_t t = static_cast<size_t>(at(i).kind());
+        species[t].push_back(i);
+        bounds[t].add(at(i).x(), at(i).y());
+        ++counts[t];
+    }
+    if (!matrix.canKill(counts)) return;
+
+    // Reported in the i<j pair order of a full scan, as Editor::runBattle does.
+    struct Kill {
+        uint64_t order;
+        uint32_t killer, victim;
+    };
+    std::vector<Kill> kills;
+
+    auto fight = [&](uint32_t i, uint32_t j) {
+        const NPC &A = at(i);
+        const NPC &B = at(j);
+        double dx = A.x() - B.x();
+        double dy = A.y() - B.y();
+        if (dx*dx + dy*dy > d2) return;
+
+        uint64_t pair = i < j ? (uint64_t{i} << 32 | j) : (uint64_t{j} << 32 | i);
+        if (std::visit(rules, npcs_[i], npcs_[j])) kills.push_back({pair << 1 | (i > j), i, j});
+        if (std::visit(rules, npcs_[j], npcs_[i])) kills.push_back({pair << 1 | (j > i), j, i});
+    };
+
+    for (auto [a, b] : matrix.interactingPairs()) {
+        const auto &A = species[static_cast<size_t>(a)];
+        const auto &B = species[static_cast<size_t>(b)];
+        if (A.empty() || B.empty()) continue;
+        if (bounds[static_cast<size_t>(a)].gap2(bounds[static_cast<size_t>(b)]) > d2) continue;
+
+        if (a == b) {
+            for (size_t x = 0; x < A.size(); ++x)
+                for (size_t y = x + 1; y < A.size(); ++y)
+                    fight(A[x], A[y]);
+        } else {
+            for (uint32_t i : A)
+                for (uint32_t j : B)
+                    fight(i, j);
+        }
+    }
+    if (kills.empty()) return;
+
+    std::sort(kills.begin(), kills.end(), [](const Kill &l, const Kill &r) { return l.order < r.order; });
+    std::vector<char> dead(npcs_.size(), 0);
+    std::vector<KillEvent> events;
+    events.reserve(kills.size());
+    for (const Kill &k : kills) {
+        const NPC &killer = at(k.killer);
+        const NPC &victim = at(k.victim);
+        dead[k.victim] = 1;
+        events.push_back({.killer = names_.intern(killer.name()), .victim = names_.intern(victim.name()),
+                          .killer_kind = killer.kind(), .victim_kind = victim.kind(),
+                          .x = victim.x(), .y = victim.y(),
+                          .killer_name = killer.name(), .victim_name = victim.name()});
+    }
+    for (auto &o : observers_) o->onKills(events);
+
+    size_t out = 0;
+    for (size_t i = 0; i < npcs_.size(); ++i) {
+        if (dead[i]) continue;
+        if (out != i) npcs_[out] = std::move(npcs_[i]);
+        ++out;
+    }
+    npcs_.erase(npcs_.begin() + static_cast<std::ptrdiff_t>(out), npcs_.end());
+}
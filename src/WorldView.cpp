@@ -0,0 +1,114 @@
+#include "WorldView.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static constexpr std::uint32_t WORLD_VIEW_MAGIC = 0x4c37564eu;
+
+static size_t frameBytes(std::uint32_t capacity) {
+    size_t bytes = sizeof(WorldViewFrame) + capacity * sizeof(WorldViewEntry);
+    return (bytes + 63) & ~size_t(63);
+}
+
+static size_t headerBytes() {
+    return (sizeof(WorldViewHeader) + 63) & ~size_t(63);
+}
+
+WorldViewPublisher::WorldViewPublisher(const std::string &name, std::uint32_t capacity, std::uint32_t frames)
+    : name_(name) {
+    if (capacity == 0 || frames == 0) throw std::invalid_argument("Empty world view");
+
+    int fd = ::shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) throw std::runtime_error("shm_open failed: " + std::string(std::strerror(errno)));
+
+    size_ = headerBytes() + frames * frameBytes(capacity);
+    if (::ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+        ::close(fd);
+        ::shm_unlink(name.c_str());
+        throw std::runtime_error("ftruncate failed: " + std::string(std::strerror(errno)));
+    }
+    base_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base_ == MAP_FAILED) {
+        ::shm_unlink(name.c_str());
+        throw std::runtime_error("mmap failed: " + std::string(std::strerror(errno)));
+    }
+
+    std::memset(base_, 0, size_);
+    header_ = static_cast<WorldViewHeader*>(base_);
+    header_->frame_count = frames;
+    header_->capacity = capacity;
+    header_->frame_bytes = static_cast<std::uint32_t>(frameBytes(capacity));
+    std::atomic_thread_fence(std::memory_order_release);
+    header_->magic = WORLD_VIEW_MAGIC;
+}
+
+WorldViewPublisher::~WorldViewPublisher() {
+    ::munmap(base_, size_);
+    ::shm_unlink(name_.c_str());
+}
+
+void WorldViewPublisher::publish(const WorldSnapshot &snap) {
+    ++tick_;
+    auto *f = reinterpret_cast<WorldViewFrame*>(static_cast<char*>(base_) + headerBytes() +
+        (tick_ % header_->frame_count) * header_->frame_bytes);
+
+    std::uint64_t seq = f->seq.load(std::memory_order_relaxed);
+    f->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    std::uint32_t count = static_cast<std::uint32_t>(
+        std::min<size_t>(snap.npcs.size(), header_->capacity));
+    for (std::uint32_t i = 0; i < count; ++i) {
+        const auto& npc = snap.npcs[i];
+        f->entries()[i] = {static_cast<float>(npc->x()), static_cast<float>(npc->y()),
+                         static_cast<std::uint8_t>(npc->kind()), {}};
+    }
+    f->tick = tick_;
+    f->count = count;
+    f->population = static_cast<std::uint32_t>(std::min<size_t>(snap.npcs.size(), UINT32_MAX));
+
+    f->seq.store(seq + 2, std::memory_order_release);
+    header_->latest_tick.store(tick_, std::memory_order_release);
+}
+
+WorldViewReader::WorldViewReader(const std::string &name) {
+    int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) throw std::runtime_error("World view not found: " + name);
+
+    off_t size = ::lseek(fd, 0, SEEK_END);
+    if (size < static_cast<off_t>(sizeof(WorldViewHeader))) {
+        ::close(fd);
+        throw std::runtime_error("World view not ready: " + name);
+    }
+    size_ = static_cast<size_t>(size);
+    base_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base_ == MAP_FAILED) throw std::runtime_error("mmap failed: " + std::string(std::strerror(errno)));
+
+    header_ = static_cast<const WorldViewHeader*>(base_);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header_->magic != WORLD_VIEW_MAGIC ||
+        headerBytes() + size_t(header_->frame_count) * header_->frame_bytes > size_) {
+        ::munmap(base_, size_);
+        throw std::runtime_error("World view not ready: " + name);
+    }
+}
+
+WorldViewReader::~WorldViewReader() {
+    ::munmap(base_, size_);
+}
+
+std::uint64_t WorldViewReader::latestTick() const {
+    return header_->latest_tick.load(std::memory_order_acquire);
+}
+
+const WorldViewFrame* WorldViewReader::frame(std::uint64_t tick) const {
+    return reinterpret_cast<const WorldViewFrame*>(static_cast<const char*>(base_) + headerBytes() +
+        (tick % header_->frame_count) * header_->frame_bytes);
+}
@@ -4,12 +4,35 @@
 #include "../includes/Observer.h"
 #include "../includes/Game.h"
 #include "../includes/FightRules.h"
+#include "../includes/KillMatrix.h"
+#include "../includes/ShardedWorld.h"
+#include "../includes/WorldView.h"
+#include "../includes/VariantWorld.h"
+#include "../includes/CompactWorld.h"
+#include "../includes/EventLog.h"
+#include "../includes/SaveFile.h"
+#include "../includes/Trajectory.h"
+#include "../includes/BatchRunner.h"
+#include "../includes/Placement.h"
+#include "../includes/Trace.h"
+#include "../includes/DiscreteEventSim.h"
+#include "../includes/SnapshotBuilder.h"
 #include <sstream>
 #include <thread>
 #include <chrono>
 #include <filesystem>
 #include <fstream>
 #include <atomic>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <map>
+#include <set>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 struct TestObserver : FightObserver {
     std::vector<std::pair<std::string,std::string>> events;
@@ -171,6 +194,122 @@ TEST(EditorTest, PrintAllOutput) {
     EXPECT_NE(output.find("Desman"), std::string::npos);
 }
 
+TEST(EditorTest, ParallelLoadMatchesSaveAndRejectsDuplicates) {
+    const std::string filename = "test_parallel_load.txt";
+    Editor ed;
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<> pos(0.0, 500.0);
+    for (int i = 0; i < 3000; ++i)
+        ed.addNPC(NPCFactory::create(static_cast<NPCType>(i % 3), "N" + std::to_string(i), pos(rng), pos(rng)));
+    ed.saveToFile(filename);
+    
+    Editor loaded;
+    loaded.loadFromFile(filename, 4);
+    ASSERT_EQ(loaded.size(), ed.size());
+    for (size_t i = 0; i < ed.npcs().size(); ++i) {
+        EXPECT_EQ(loaded.npcs()[i]->name(), ed.npcs()[i]->name());
+        EXPECT_EQ(loaded.npcs()[i]->kind(), ed.npcs()[i]->kind());
+        EXPECT_NEAR(loaded.npcs()[i]->x(), ed.npcs()[i]->x(), 1e-3);
+    }
+    EXPECT_EQ(loaded.stats().count(NPCType::Desman), ed.stats().count(NPCType::Desman));
+    
+    {
+        std::ofstream out(filename, std::ios::app);
+        out << "bear N17 1 1\n";
+    }
+    try {
+        loaded.loadFromFile(filename, 4);
+        FAIL() << "duplicate in another chunk was accepted";
+    } catch (const std::runtime_error &e) {
+        EXPECT_STREQ(e.what(), "Invalid or duplicate NPC in file");
+    }
+    
+    {
+        std::ofstream out(filename);
+        out << "Bear A 1 1\nDesman B 600 1\n";
+    }
+    EXPECT_THROW(loaded.loadFromFile(filename, 2), std::runtime_error);
+    {
+        std::ofstream out(filename);
+        out << "Bear A 1 1\nDesman B x 1\n";
+    }
+    EXPECT_THROW(loaded.loadFromFile(filename, 2), std::runtime_error);
+    
+    std::filesystem::remove(filename);
+}
+
+TEST(EditorTest, ParallelLoadKeepsSerialGrammarAndErrorOrder) {
+    const std::string filename = "test_parallel_grammar.txt";
+    {
+        // One token per line, so most chunk cuts land inside a record.
+        std::ofstream out(filename);
+        for (int i = 0; i < 500; ++i)
+            out << "Desman\nD" << i << "\n" << i % 400 << "\n" << (i * 7) % 400 << "\n";
+    }
+    Editor ed;
+    ed.loadFromFile(filename, 7);
+    ASSERT_EQ(ed.size(), 500u);
+    EXPECT_EQ(ed.npcs()[123]->name(), "D123");
+    EXPECT_DOUBLE_EQ(ed.npcs()[123]->y(), (123 * 7) % 400);
+    
+    auto loadError = [&](const std::string &text) {
+        {
+            std::ofstream out(filename);
+            out << text;
+        }
+        try {
+            ed.loadFromFile(filename, 2);
+        } catch (const std::runtime_error &e) {
+            return std::string(e.what());
+        }
+        return std::string();
+    };
+    std::string filler;
+    for (int i = 0; i < 200; ++i) filler += "Bear F" + std::to_string(i) + " 1 1\n";
+    EXPECT_EQ(loadError("Bear A 1 1\nBear A 2 2\n" + filler + "Bear B x 1\n"), "Invalid or duplicate NPC in file");
+    EXPECT_EQ(loadError("Bear B x 1\n" + filler + "Bear F0 1 1\n"), "Bad NPC format");
+    
+    // A leading '+' loads as it did through operator>>; "+-" does not.
+    EXPECT_EQ(loadError("Bear P +12.5 +3\n"), "");
+    ASSERT_EQ(ed.size(), 1u);
+    EXPECT_DOUBLE_EQ(ed.npcs()[0]->x(), 12.5);
+    EXPECT_DOUBLE_EQ(ed.npcs()[0]->y(), 3.0);
+    EXPECT_EQ(loadError("Bear P +-12.5 3\n"), "Bad NPC format");
+    
+    std::filesystem::remove(filename);
+}
+
+TEST(EditorTest, ParallelSaveIsByteIdentical) {
+    for (double v : {0.0, 0.1, 1e-7, 123456789.0, 499.99999, 1.0 / 3.0, 250.5, 1e21, -2.5}) {
+        auto npc = NPCFactory::create(NPCType::Bittern, "V", v, 1.0 - v);
+        std::ostringstream expected;
+        npc->serialize(expected);
+        std::string got;
+        appendNPCRecord(got, *npc);
+        EXPECT_EQ(got, expected.str());
+    }
+    
+    const std::string filename = "test_parallel_save.txt";
+    Editor ed;
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<> pos(0.0, 500.0);
+    for (int i = 0; i < 1000; ++i)
+        ed.addNPC(NPCFactory::create(static_cast<NPCType>(i % 3), "S" + std::to_string(i), pos(rng), pos(rng)));
+    ed.kill(ed.handles()[10]);
+    
+    std::ostringstream expected;
+    for (auto &n : ed.npcs())
+        if (n) n->serialize(expected);
+    
+    ed.saveToFile(filename, 3);
+    std::ifstream in(filename, std::ios::binary);
+    std::string written((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(written, expected.str());
+    EXPECT_FALSE(std::filesystem::exists(filename + ".tmp"));
+    
+    std::filesystem::remove(filename);
+}
+
 TEST(EditorTest, EmptyEditorOperations) {
     Editor ed;
     
@@ -190,6 +329,191 @@ TEST(EditorTest, EmptyEditorOperations) {
     std::filesystem::remove(filename);
 }
 
+TEST(EditorTest, NameTableInternsOnce) {
+    NameTable table;
+    NPCId a = table.intern("Ursa");
+    NPCId b = table.intern("Heron");
+    
+    EXPECT_EQ(table.intern("Ursa"), a);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(table.find("Heron"), b);
+    EXPECT_EQ(table.find("Nobody"), INVALID_NPC_ID);
+    
+    NameTable copy = table;
+    EXPECT_EQ(copy.find("Ursa"), a);
+    EXPECT_EQ(copy.name(b), "Heron");
+}
+
+TEST(EditorTest, KillMatrixMatchesFightRules) {
+    const KillMatrix &matrix = KillMatrix::standard();
+    FightRules rules;
+    for (size_t a = 0; a < NPC_TYPE_COUNT; ++a) {
+        for (size_t b = 0; b < NPC_TYPE_COUNT; ++b) {
+            auto attacker = NPCFactory::create(static_cast<NPCType>(a), "A", 0, 0);
+            auto defender = NPCFactory::create(static_cast<NPCType>(b), "D", 0, 0);
+            EXPECT_EQ(matrix.kills(attacker->kind(), defender->kind()), attacker->accept(rules, *defender));
+        }
+    }
+    
+    std::vector<std::pair<NPCType, NPCType>> expected = {
+        {NPCType::Bear, NPCType::Bittern}, {NPCType::Bear, NPCType::Desman}};
+    EXPECT_EQ(matrix.interactingPairs(), expected);
+    EXPECT_FALSE(matrix.interacts(NPCType::Bittern, NPCType::Desman));
+    EXPECT_TRUE(matrix.interacts(NPCType::Desman, NPCType::Bear));
+}
+
+TEST(EditorTest, BattleSkipsTerminalAndSeparatedSpecies) {
+    auto observer = std::make_shared<TestObserver>();
+    
+    Editor peaceful;
+    peaceful.addObserver(observer);
+    peaceful.addNPC(NPCFactory::create(NPCType::Bittern, "I1", 0.0, 0.0));
+    peaceful.addNPC(NPCFactory::create(NPCType::Desman, "D1", 0.0, 0.0));
+    peaceful.runBattle(100.0);
+    EXPECT_TRUE(observer->events.empty());
+    EXPECT_EQ(peaceful.size(), 2u);
+    
+    Editor apart;
+    apart.addObserver(observer);
+    apart.addNPC(NPCFactory::create(NPCType::Bear, "B1", 0.0, 0.0));
+    apart.addNPC(NPCFactory::create(NPCType::Bear, "B2", 10.0, 0.0));
+    apart.addNPC(NPCFactory::create(NPCType::Desman, "D1", 400.0, 400.0));
+    apart.runBattle(50.0);
+    EXPECT_TRUE(observer->events.empty());
+    
+    // One pass decides everything: B1 kills I1 and D1 while D1 kills B1;
+    // kills are simultaneous, so nobody is left to fight another round.
+    Editor chain;
+    chain.addObserver(observer);
+    chain.addNPC(NPCFactory::create(NPCType::Bear, "B1", 10.0, 0.0));
+    chain.addNPC(NPCFactory::create(NPCType::Bittern, "I1", 15.0, 0.0));
+    chain.addNPC(NPCFactory::create(NPCType::Desman, "D1", 5.0, 0.0));
+    chain.addNPC(NPCFactory::create(NPCType::Bittern, "I2", 200.0, 0.0));
+    chain.runBattle(6.0);
+    ASSERT_EQ(chain.size(), 1u);
+    EXPECT_EQ(chain.npcs()[0]->name(), "I2");
+    EXPECT_EQ(observer->events.size(), 3u);
+}
+
+TEST(EditorTest, PopulationStatsTrackSpawnMoveKill) {
+    Editor ed;
+    ed.addNPC(NPCFactory::create(NPCType::Bear, "B1", 5.0, 5.0));
+    ed.addNPC(NPCFactory::create(NPCType::Bear, "B2", 95.0, 5.0));
+    ed.addNPC(NPCFactory::create(NPCType::Desman, "D1", 5.0, 5.0));
+    ed.enableRegionStats(10, 10, 100.0, 100.0);
+    
+    const auto& stats = ed.stats();
+    EXPECT_EQ(stats.total(), 3);
+    EXPECT_EQ(stats.count(NPCType::Bear), 2);
+    EXPECT_EQ(stats.count(NPCType::Bittern), 0);
+    EXPECT_EQ(stats.regionCount(0, 0), 2);
+    EXPECT_EQ(stats.regionCount(9, 0, NPCType::Bear), 1);
+    
+    NPCHandle b1 = ed.handleOf(ed.names().find("B1"));
+    ed.moveNPC(b1, 55.0, 55.0);
+    EXPECT_EQ(stats.regionCount(0, 0, NPCType::Bear), 0);
+    EXPECT_EQ(stats.regionCount(5, 5, NPCType::Bear), 1);
+    
+    ed.runBattle(1.0);
+    EXPECT_EQ(stats.total(), 3);
+    ed.kill(b1);
+    EXPECT_EQ(stats.count(NPCType::Bear), 1);
+    EXPECT_EQ(stats.regionCount(5, 5), 0);
+    EXPECT_EQ(stats.total(), static_cast<int>(ed.size()));
+}
+
+TEST(EditorTest, SpatialQueriesMatchBruteForce) {
+    Editor ed;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<> pos(0.0, 500.0);
+    for (int i = 0; i < 400; ++i)
+        ed.addNPC(NPCFactory::create(static_cast<NPCType>(i % 3), "N" + std::to_string(i), pos(rng), pos(rng)));
+    for (int i = 0; i < 100; ++i)
+        ed.moveNPC(ed.handles()[i], pos(rng), pos(rng));
+    for (int i = 100; i < 150; ++i)
+        ed.kill(ed.handles()[i]);
+    
+    auto live = [&] {
+        std::vector<std::pair<NPCHandle, NPCPtr>> all;
+        for (size_t i = 0; i < ed.npcs().size(); ++i)
+            if (ed.npcs()[i]) all.emplace_back(ed.handles()[i], ed.npcs()[i]);
+        return all;
+    }();
+    auto d2 = [](const NPCPtr &n, double x, double y) {
+        return (n->x() - x) * (n->x() - x) + (n->y() - y) * (n->y() - y);
+    };
+    
+    for (int q = 0; q < 20; ++q) {
+        double x = pos(rng), y = pos(rng);
+        
+        size_t expected = 0, got = 0;
+        for (auto &[h, n] : live) expected += d2(n, x, y) <= 60.0 * 60.0;
+        ed.queryRadius(x, y, 60.0, [&](NPCHandle, const NPC &n) {
+            EXPECT_LE((n.x() - x) * (n.x() - x) + (n.y() - y) * (n.y() - y), 3600.0);
+            ++got;
+        });
+        EXPECT_EQ(got, expected);
+        
+        expected = got = 0;
+        for (auto &[h, n] : live)
+            expected += n->x() >= x - 30 && n->x() <= x + 45 && n->y() >= y - 10 && n->y() <= y + 70;
+        ed.queryBox(x - 30, y - 10, x + 45, y + 70, [&](NPCHandle, const NPC &) { ++got; });
+        EXPECT_EQ(got, expected);
+        
+        std::vector<double> bears;
+        for (auto &[h, n] : live)
+            if (n->kind() == NPCType::Bear) bears.push_back(d2(n, x, y));
+        std::sort(bears.begin(), bears.end());
+        
+        std::array<NPCHandle, 5> out;
+        size_t k = ed.nearestK(x, y, out, [](const NPC &n) { return n.kind() == NPCType::Bear; });
+        ASSERT_EQ(k, out.size());
+        for (size_t i = 0; i < k; ++i)
+            EXPECT_DOUBLE_EQ(d2(ed.find(out[i]), x, y), bears[i]);
+    }
+    
+    std::array<NPCHandle, 8> all;
+    Editor small;
+    small.addNPC(NPCFactory::create(NPCType::Bear, "Only", 1.0, 1.0));
+    EXPECT_EQ(small.nearestK(499.0, 499.0, all), 1u);
+}
+
+TEST(EditorTest, MoveAndKillByHandle) {
+    Editor ed;
+    ed.addNPC(NPCFactory::create(NPCType::Bear, "B1", 0.0, 0.0));
+    ed.addNPC(NPCFactory::create(NPCType::Bittern, "I1", 10.0, 10.0));
+    ed.addNPC(NPCFactory::create(NPCType::Desman, "D1", 20.0, 20.0));
+    
+    NPCHandle bittern = ed.handleOf(ed.names().find("I1"));
+    ASSERT_EQ(ed.handles()[1], bittern);
+    EXPECT_EQ(ed.names().name(ed.idOf(bittern)), "I1");
+    
+    EXPECT_TRUE(ed.moveNPC(bittern, 15.0, 16.0));
+    EXPECT_DOUBLE_EQ(ed.find(bittern)->x(), 15.0);
+    EXPECT_FALSE(ed.moveNPC(bittern, 600.0, 16.0));
+    
+    EXPECT_TRUE(ed.kill(bittern));
+    EXPECT_FALSE(ed.kill(bittern));
+    EXPECT_EQ(ed.size(), 2u);
+    EXPECT_EQ(ed.tombstones(), 1u);
+    EXPECT_EQ(ed.npcs()[1], nullptr);
+    EXPECT_EQ(ed.find(bittern), nullptr);
+    EXPECT_FALSE(ed.moveNPC(bittern, 1.0, 1.0));
+    
+    NPCHandle desman = ed.handles()[2];
+    ed.compact();
+    ASSERT_EQ(ed.npcs().size(), 2u);
+    EXPECT_EQ(ed.npcs()[1]->name(), "D1");
+    EXPECT_EQ(ed.find(desman)->name(), "D1");
+    
+    EXPECT_TRUE(ed.addNPC(NPCFactory::create(NPCType::Bittern, "I1", 5.0, 5.0)));
+    NPCHandle reborn = ed.handleOf(ed.names().find("I1"));
+    EXPECT_EQ(reborn.index, bittern.index);
+    EXPECT_NE(reborn, bittern);
+    EXPECT_EQ(ed.find(bittern), nullptr);
+    EXPECT_EQ(ed.find(reborn)->name(), "I1");
+}
+
 TEST(Variant19RulesTest, BearKillsEveryoneExceptBears) {
     FightRules rules;
     
@@ -369,6 +693,296 @@ TEST(ObserverTest, MultipleObserversReceiveEvents) {
     }
 }
 
+struct BatchObserver : FightObserver {
+    std::vector<size_t> batches;
+    std::vector<std::pair<std::string,std::string>> events;
+    void onKill(const std::string &, const std::string &) override {
+        ADD_FAILURE() << "batched observer received a single event";
+    }
+    void onKills(std::span<const KillEvent> kills) override {
+        batches.push_back(kills.size());
+        for (auto &k : kills) events.emplace_back(k.killer_name, k.victim_name);
+    }
+};
+
+TEST(ObserverTest, BatchedDispatchOncePerRound) {
+    Editor ed;
+    auto batch = std::make_shared<BatchObserver>();
+    auto legacy = std::make_shared<TestObserver>();
+    ed.addObserver(batch);
+    ed.addObserver(legacy);
+    
+    ed.addNPC(NPCFactory::create(NPCType::Bear, "BearKing", 0.0, 0.0));
+    for (int i = 0; i < 3; ++i)
+        ed.addNPC(NPCFactory::create(NPCType::Bittern, "Bit" + std::to_string(i), i + 1.0, 0.0));
+    
+    ed.runBattle(10.0);
+    
+    ASSERT_EQ(batch->batches.size(), 1u);
+    EXPECT_EQ(batch->batches[0], 3u);
+    EXPECT_EQ(batch->events, legacy->events);
+    EXPECT_EQ(legacy->events[2].first, "BearKing");
+    EXPECT_EQ(legacy->events[2].second, "Bit2");
+}
+
+TEST(ObserverTest, FileObserverBatchFormat) {
+    const std::string filename = "test_batch_log.txt";
+    std::filesystem::remove(filename);
+    
+    NameTable names;
+    std::vector<KillEvent> events = {{names.intern("A"), names.intern("B")}, {names.intern("C"), names.intern("D")}};
+    for (auto &e : events) {
+        e.killer_name = names.name(e.killer);
+        e.victim_name = names.name(e.victim);
+    }
+    FileObserver(filename).onKills(events);
+    
+    std::ifstream file(filename);
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(content, "A killed B\nC killed D\n");
+    std::filesystem::remove(filename);
+}
+
+TEST(TrajectoryTest, RecorderRoundTripAcrossGroups) {
+    const std::string filename = "test_trajectory.bin";
+    Editor ed;
+    ed.addNPC(NPCFactory::create(NPCType::Bear, "Walker", 10.0, 10.0));
+    ed.addNPC(NPCFactory::create(NPCType::Desman, "Swimmer", 50.0, 20.0));
+    NPCHandle walker = ed.handles()[0];
+    
+    auto snapshotOf = [&](std::uint64_t version) {
+        auto snap = std::make_shared<WorldSnapshot>();
+        snap->version = version;
+        for (size_t i = 0; i < ed.npcs().size(); ++i) {
+            if (!ed.npcs()[i]) continue;
+            snap->npcs.push_back(ed.npcs()[i]);
+            snap->ids.push_back(ed.idOf(ed.handles()[i]));
+        }
+        return SnapshotPtr(std::move(snap));
+    };
+    
+    {
+        TrajectoryOptions opts;
+        opts.ticks_per_group = 3;
+        TrajectoryRecorder recorder(filename, opts);
+        for (int t = 1; t <= 7; ++t) {
+            ed.moveNPC(walker, 10.0 + t * 1.25, 10.0 - t * 0.5);
+            if (t == 5) ed.kill(ed.handles()[1]);
+            EXPECT_TRUE(recorder.record(snapshotOf(t * 10)));
+        }
+        recorder.close();
+        EXPECT_EQ(recorder.recorded(), 7u);
+        EXPECT_FALSE(recorder.record(snapshotOf(80)));
+    }
+    
+    TrajectoryReader reader(filename);
+    TrajectoryTick tick;
+    int t = 0;
+    while (reader.next(tick)) {
+        ++t;
+        EXPECT_EQ(tick.tick, static_cast<std::uint64_t>(t * 10));
+        ASSERT_EQ(tick.rows.size(), t < 5 ? 2u : 1u);
+        EXPECT_EQ(reader.name(tick.rows[0].id), "Walker");
+        EXPECT_EQ(tick.rows[0].kind, NPCType::Bear);
+        EXPECT_NEAR(tick.rows[0].x, 10.0 + t * 1.25, 0.01);
+        EXPECT_NEAR(tick.rows[0].y, 10.0 - t * 0.5, 0.01);
+        if (t < 5) {
+            EXPECT_EQ(reader.name(tick.rows[1].id), "Swimmer");
+            EXPECT_DOUBLE_EQ(tick.rows[1].x, 50.0);
+        }
+    }
+    EXPECT_EQ(t, 7);
+    std::filesystem::remove(filename);
+}
+
+TEST(TrajectoryTest, GameRecordsWhileRunning) {
+    const std::string filename = "test_game_trajectory.bin";
+    const std::string checkpoint = "test_game_trajectory.txt";
+    {
+        Editor ed;
+        ed.addNPC(NPCFactory::create(NPCType::Bittern, "Bit1", 10.0, 10.0));
+        ed.addNPC(NPCFactory::create(NPCType::Bear, "Bear1", 95.0, 5.0));
+        ed.saveToFile(checkpoint);
+    }
+    {
+        GameConfig config;
+        config.trajectory = filename;
+        config.event_log.clear();
+        config.verbose = false;
+        Game game(config);
+        game.start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        game.stop();
+        
+        // A second run appends to the file instead of being dropped.
+        game.resume(checkpoint);
+        game.start();
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        game.stop();
+    }
+    
+    TrajectoryReader reader(filename);
+    TrajectoryTick tick;
+    ASSERT_TRUE(reader.next(tick));
+    EXPECT_EQ(tick.rows.size(), 50u);
+    std::uint64_t last = tick.tick;
+    size_t ticks = 1;
+    bool second_run = false;
+    while (reader.next(tick)) {
+        EXPECT_GT(tick.tick, last);
+        last = tick.tick;
+        ++ticks;
+        second_run = tick.rows.size() == 2;
+    }
+    // One tick per 100 ms logging tick, not one per move.
+    EXPECT_LE(ticks, 12u);
+    EXPECT_TRUE(second_run);
+    std::filesystem::remove(filename);
+    std::filesystem::remove(checkpoint);
+}
+
+TEST(EventLogTest, RoundTripAndRotation) {
+    const std::string base = "test_event_log";
+    for (int s = 0; s < 8; ++s) std::filesystem::remove(eventLogSegmentPath(base, s));
+    
+    NameTable names;
+    NPCId bear = names.intern("Ursa0");
+    NPCId bird = names.intern("Heron1");
+    
+    EventLogOptions opts;
+    opts.max_bytes = 64;
+    {
+        EventLogWriter log(base, opts);
+        for (int i = 0; i < 10; ++i) {
+            log.append({static_cast<std::uint64_t>(i), bear, bird, NPCType::Bear, NPCType::Bittern, 12.345 + i, 99.0},
+                       names.name(bear), names.name(bird));
+        }
+        EXPECT_GT(log.segment(), 0u);
+    }
+    
+    int decoded = 0;
+    for (int s = 0; std::filesystem::exists(eventLogSegmentPath(base, s)); ++s) {
+        EventLogReader reader(eventLogSegmentPath(base, s));
+        KillRecord r;
+        while (reader.next(r)) {
+            EXPECT_EQ(r.tick, static_cast<std::uint64_t>(decoded));
+            EXPECT_EQ(reader.name(r.killer), "Ursa0");
+            EXPECT_EQ(reader.name(r.victim), "Heron1");
+            EXPECT_EQ(r.victim_kind, NPCType::Bittern);
+            EXPECT_NEAR(r.x, 12.345 + decoded, 0.01);
+            EXPECT_DOUBLE_EQ(r.y, 99.0);
+            ++decoded;
+        }
+        std::filesystem::remove(eventLogSegmentPath(base, s));
+    }
+    EXPECT_EQ(decoded, 10);
+}
+
+TEST(EventLogTest, RotatesByAgeWithFewRecords) {
+    const std::string base = "test_event_log_age";
+    for (int s = 0; s < 4; ++s) std::filesystem::remove(eventLogSegmentPath(base, s));
+    
+    NameTable names;
+    NPCId bear = names.intern("Ursa0");
+    NPCId bird = names.intern("Heron1");
+    
+    EventLogOptions opts;
+    opts.max_age = std::chrono::milliseconds(20);
+    {
+        EventLogWriter log(base, opts);
+        log.append({1, bear, bird, NPCType::Bear, NPCType::Bittern, 1.0, 2.0}, names.name(bear), names.name(bird));
+        EXPECT_EQ(log.segment(), 0u);
+        std::this_thread::sleep_for(std::chrono::milliseconds(40));
+        log.append({2, bear, bird, NPCType::Bear, NPCType::Bittern, 3.0, 4.0}, names.name(bear), names.name(bird));
+        EXPECT_EQ(log.segment(), 1u);
+    }
+    
+    for (int s = 0; s < 2; ++s) {
+        EventLogReader reader(eventLogSegmentPath(base, s));
+        KillRecord r;
+        ASSERT_TRUE(reader.next(r));
+        EXPECT_EQ(r.tick, static_cast<std::uint64_t>(s + 1));
+        EXPECT_EQ(reader.name(r.killer), "Ursa0");
+        EXPECT_FALSE(reader.next(r));
+        std::filesystem::remove(eventLogSegmentPath(base, s));
+    }
+    
+    BinaryLogObserver observer(base);
+    EXPECT_THROW(observer.onKill("Ursa0", "Heron1"), std::logic_error);
+    std::filesystem::remove(eventLogSegmentPath(base, 0));
+}
+
+TEST(EventLogTest, BinaryObserverRecordsBattle) {
+    const std::string base = "test_binary_observer";
+    std::filesystem::remove(eventLogSegmentPath(base, 0));
+    {
+        Editor ed;
+        ed.addObserver(std::make_shared<BinaryLogObserver>(base));
+        ed.addNPC(NPCFactory::create(NPCType::Bear, "Bear1", 0.0, 0.0));
+        ed.addNPC(NPCFactory::create(NPCType::Bittern, "Bit1", 1.0, 2.0));
+        ed.runBattle(5.0);
+    }
+    
+    EventLogReader reader(eventLogSegmentPath(base, 0));
+    KillRecord r;
+    ASSERT_TRUE(reader.next(r));
+    EXPECT_EQ(reader.name(r.killer), "Bear1");
+    EXPECT_EQ(reader.name(r.victim), "Bit1");
+    EXPECT_EQ(r.killer_kind, NPCType::Bear);
+    EXPECT_DOUBLE_EQ(r.y, 2.0);
+    EXPECT_FALSE(reader.next(r));
+    std::filesystem::remove(eventLogSegmentPath(base, 0));
+}
+
+TEST(SnapshotTest, BuilderReplaysChangesIntoSpares) {
+    Editor ed;
+    for (int i = 0; i < 500; ++i)
+        ed.addNPC(NPCFactory::create(static_cast<NPCType>(i % 3), "N" + std::to_string(i), i % 400, i / 2));
+    SnapshotBuilder builder;
+    builder.reset(ed);
+    auto first = builder.build();
+    EXPECT_EQ(first->version, 1u);
+    EXPECT_EQ(first->npcs.size(), 500u);
+    
+    auto matches = [&](const WorldSnapshot &snap) {
+        std::map<NPCId, const NPC*> live;
+        for (size_t i = 0; i < ed.npcs().size(); ++i)
+            if (ed.npcs()[i]) live[ed.idOf(ed.handles()[i])] = ed.npcs()[i].get();
+        std::map<NPCId, const NPC*> seen;
+        for (size_t i = 0; i < snap.npcs.size(); ++i) {
+            EXPECT_EQ(ed.find(snap.handles[i]).get(), snap.npcs[i].get());
+            seen[snap.ids[i]] = snap.npcs[i].get();
+        }
+        return seen == live;
+    };
+    
+    std::mt19937 gen(7);
+    std::vector<std::pair<std::shared_ptr<const WorldSnapshot>, std::vector<NPCPtr>>> held;
+    for (int round = 0; round < 300; ++round) {
+        for (int k = 0; k < 3; ++k) {
+            NPCHandle h = ed.handles()[gen() % ed.handles().size()];
+            if (!ed.find(h)) continue;
+            if (gen() % 4 == 0) {
+                ASSERT_TRUE(ed.kill(h));
+                builder.removed(h);
+            } else {
+                ASSERT_TRUE(ed.moveNPC(h, gen() % 500, gen() % 500));
+                builder.moved(h, ed.find(h));
+            }
+        }
+        ed.compactIfSparse();
+        auto snap = builder.build();
+        ASSERT_EQ(snap->version, round + 2u);
+        ASSERT_TRUE(matches(*snap)) << "round " << round;
+        // A reader that keeps a snapshot must never see it change.
+        if (round % 50 == 0) held.emplace_back(snap, snap->npcs);
+    }
+    for (const auto &[snap, npcs] : held) EXPECT_EQ(snap->npcs, npcs);
+    // Only the first build after reset and the one or two builds right after
+    // a reader pinned a spare copy the world.
+    EXPECT_LE(builder.fullCopies(), 2u * held.size() + 2);
+}
+
 TEST(GameTest, ConstructorAndDestructor) {
     {
         Game game;
@@ -426,6 +1040,683 @@ TEST(GameTest, InitialNPCCount) {
     SUCCEED();
 }
 
+TEST(GameTest, CheckpointWhileRunning) {
+    const std::string filename = "test_checkpoint.txt";
+    Game game;
+    
+    game.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto done = game.checkpoint(filename);
+    done.get();
+    
+    Editor ed;
+    ed.loadFromFile(filename);
+    EXPECT_FALSE(ed.npcs().empty());
+    EXPECT_LE(ed.npcs().size(), 50);
+    EXPECT_FALSE(std::filesystem::exists(filename + ".tmp"));
+    
+    game.stop();
+    std::filesystem::remove(filename);
+}
+
+TEST(GameTest, ResumeFromCheckpoint) {
+    const std::string filename = "test_resume.txt";
+    {
+        Editor ed;
+        ed.addNPC(NPCFactory::create(NPCType::Bittern, "Bit1", 10.0, 10.0));
+        ed.addNPC(NPCFactory::create(NPCType::Bittern, "Bit2", 90.0, 90.0));
+        ed.addNPC(NPCFactory::create(NPCType::Bittern, "Bit3", 50.0, 50.0));
+        // Far from every bittern, but keeps the game from ending at once.
+        ed.addNPC(NPCFactory::create(NPCType::Bear, "Bear1", 95.0, 5.0));
+        ed.saveToFile(filename);
+    }
+    
+    Game game;
+    game.resume(filename);
+    EXPECT_EQ(game.getAliveCount(), 4);
+    EXPECT_EQ(game.snapshot()->npcs.size(), 4);
+    
+    game.start();
+    EXPECT_THROW(game.resume(filename), std::logic_error);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    game.stop();
+    
+    EXPECT_EQ(game.getAliveCount(), 4);
+    EXPECT_THROW(Game().resume("missing_checkpoint.txt"), std::runtime_error);
+    std::filesystem::remove(filename);
+}
+
+TEST(GameTest, EndsEarlyWhenNoKillsPossible) {
+    const std::string filename = "test_terminal.txt";
+    {
+        Editor ed;
+        ed.addNPC(NPCFactory::create(NPCType::Bittern, "Bit1", 10.0, 10.0));
+        ed.addNPC(NPCFactory::create(NPCType::Desman, "Des1", 12.0, 10.0));
+        ed.saveToFile(filename);
+    }
+    
+    GameConfig config;
+    config.event_log.clear();
+    Game game(config);
+    game.resume(filename);
+    
+    auto start = std::chrono::steady_clock::now();
+    game.start();
+    game.waitForFinish();
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(2));
+    EXPECT_TRUE(game.endedEarly());
+    EXPECT_EQ(game.getAliveCount(), 2);
+    std::filesystem::remove(filename);
+}
+
+TEST(GameTest, WorldViewPublishesFrames) {
+    const std::string name = "/lab7_test_world_" + std::to_string(::getpid());
+    Game game;
+    game.enableWorldView(name, 64);
+    
+    WorldViewReader reader(name);
+    EXPECT_EQ(reader.latestTick(), 1);
+    
+    game.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    
+    std::uint32_t seen = 0;
+    bool ok = false;
+    for (int attempt = 0; attempt < 10 && !ok; ++attempt) {
+        ok = reader.visitLatest([&](const WorldViewFrame &f) {
+            seen = 0;
+            for (std::uint32_t i = 0; i < f.count; ++i) {
+                if (f.entries()[i].type < 3) ++seen;
+            }
+            EXPECT_EQ(f.population, f.count);
+        });
+    }
+    game.stop();
+    
+    EXPECT_TRUE(ok);
+    EXPECT_GT(seen, 0u);
+    EXPECT_LE(seen, 50u);
+    EXPECT_GT(reader.latestTick(), 1);
+    
+    // A world larger than the ring's capacity is marked as cut off.
+    const std::string small = name + "_small";
+    WorldViewPublisher publisher(small, 8);
+    WorldSnapshot snap;
+    for (int i = 0; i < 20; ++i)
+        snap.npcs.push_back(NPCFactory::create(NPCType::Bear, "V" + std::to_string(i), i, i));
+    publisher.publish(snap);
+    WorldViewReader small_reader(small);
+    ASSERT_TRUE(small_reader.visitLatest([&](const WorldViewFrame &f) {
+        EXPECT_EQ(f.count, 8u);
+        EXPECT_EQ(f.population, 20u);
+        EXPECT_TRUE(f.truncated());
+    }));
+}
+
+TEST(GameTest, StopIsImmediate) {
+    Game game;
+    game.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    
+    auto begin = std::chrono::steady_clock::now();
+    game.stop();
+    auto elapsed = std::chrono::steady_clock::now() - begin;
+    
+    EXPECT_LT(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(), 200);
+}
+
+TEST(GameTest, PauseFreezesAndStepAdvances) {
+    GameConfig config;
+    config.event_log.clear();
+    config.verbose = false;
+    Game game(config);
+    
+    game.start(true);
+    EXPECT_TRUE(game.isPaused());
+    auto frozen = game.snapshot()->version;
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    EXPECT_EQ(game.snapshot()->version, frozen);
+    
+    // Every tick moves one NPC, which publishes a snapshot.
+    game.step(5);
+    EXPECT_GE(game.snapshot()->version, frozen + 5);
+    EXPECT_LE(game.getAliveCount(), 50);
+    
+    game.resume();
+    EXPECT_FALSE(game.isPaused());
+    EXPECT_THROW(game.step(), std::logic_error);
+    auto resumed = game.snapshot()->version;
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+    EXPECT_GT(game.snapshot()->version, resumed);
+    
+    game.pause();
+    auto paused = game.snapshot()->version;
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    EXPECT_EQ(game.snapshot()->version, paused);
+    
+    auto begin = std::chrono::steady_clock::now();
+    game.stop();
+    EXPECT_LT(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(200));
+}
+
+TEST(GameTest, GamesShareScheduler) {
+    GameConfig config;
+    config.scheduler = std::make_shared<Scheduler>(2);
+    
+    std::vector<std::unique_ptr<Game>> games;
+    for (int i = 0; i < 4; ++i) {
+        games.push_back(std::make_unique<Game>(config));
+        games.back()->start();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    for (auto& game : games) game->stop();
+    
+    EXPECT_EQ(config.scheduler->threadCount(), 2u);
+    for (auto& game : games) EXPECT_LE(game->getAliveCount(), 50);
+}
+
+TEST(BatchTest, HeadlessRunsAreSeededAndThreadIndependent) {
+    BatchOptions opts;
+    opts.runs = 24;
+    opts.base_seed = 7;
+    opts.duration = std::chrono::seconds(10);
+    
+    opts.threads = 1;
+    auto serial = runBatch(opts);
+    opts.threads = 3;
+    auto parallel = runBatch(opts);
+    
+    ASSERT_EQ(serial.size(), 24u);
+    ASSERT_EQ(parallel.size(), 24u);
+    for (size_t i = 0; i < serial.size(); ++i) {
+        EXPECT_EQ(serial[i].seed, 7u + i);
+        EXPECT_EQ(serial[i].initial, parallel[i].initial);
+        EXPECT_EQ(serial[i].survivors, parallel[i].survivors);
+        EXPECT_EQ(serial[i].sim_time, parallel[i].sim_time);
+        
+        int initial = 0;
+        for (size_t t = 0; t < NPC_TYPE_COUNT; ++t) {
+            initial += serial[i].initial[t];
+            EXPECT_LE(serial[i].survivors[t], serial[i].initial[t]);
+        }
+        EXPECT_EQ(initial, 50);
+        EXPECT_LE(serial[i].sim_time, opts.duration);
+    }
+    
+    auto summary = summarizeBatch(serial);
+    EXPECT_EQ(summary.runs, 24u);
+    EXPECT_EQ(summary.overall.samples, 24u);
+    EXPECT_LE(summary.overall.min, summary.overall.p50);
+    EXPECT_LE(summary.overall.p50, summary.overall.max);
+    for (const auto& species : summary.species) {
+        EXPECT_GE(species.min, 0.0);
+        EXPECT_LE(species.max, 1.0);
+    }
+    
+    const std::string path = "test_batch_summary.txt";
+    writeBatchSummary(summary, path);
+    std::ifstream in(path);
+    std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_NE(text.find("Runs: 24"), std::string::npos);
+    EXPECT_NE(text.find("Desman"), std::string::npos);
+    std::filesystem::remove(path);
+}
+
+TEST(BatchTest, HeadlessGameIsReusable) {
+    GameConfig config;
+    config.event_log.clear();
+    config.verbose = false;
+    Game game(config);
+    
+    auto first = game.runHeadless(42, std::chrono::seconds(5));
+    game.runHeadless(43, std::chrono::seconds(5));
+    auto again = game.runHeadless(42, std::chrono::seconds(5));
+    
+    EXPECT_EQ(first.survivors, again.survivors);
+    EXPECT_EQ(first.sim_time, again.sim_time);
+    EXPECT_EQ(game.getAliveCount(), again.survivors[0] + again.survivors[1] + again.survivors[2]);
+    EXPECT_EQ(game.snapshot()->npcs.size(), static_cast<size_t>(game.getAliveCount()));
+}
+
+TEST(BatchTest, BattleBudgetSlicesPasses) {
+    GameConfig config;
+    config.event_log.clear();
+    config.verbose = false;
+    
+    Game whole(config);
+    auto unsliced = whole.runHeadless(11, std::chrono::seconds(10));
+    BattleSliceStats w = whole.battleSlices();
+    EXPECT_GT(w.slices, 0u);
+    EXPECT_EQ(w.passes, w.slices);
+    
+    config.battle_budget = 25;
+    Game sliced(config);
+    auto observer = std::make_shared<BatchObserver>();
+    sliced.addObserver(observer);
+    auto result = sliced.runHeadless(11, std::chrono::seconds(10));
+    BattleSliceStats s = sliced.battleSlices();
+    EXPECT_GT(s.passes, 0u);
+    EXPECT_GT(s.slices, s.passes);
+    EXPECT_LE(s.pairs, s.slices * 25);
+    EXPECT_GE(s.max, s.last);
+    EXPECT_LE(s.max, s.total);
+    EXPECT_EQ(result.initial, unsliced.initial);
+    EXPECT_EQ(sliced.snapshot()->npcs.size(), static_cast<size_t>(sliced.getAliveCount()));
+    
+    int initial = 0, survivors = 0;
+    for (size_t t = 0; t < NPC_TYPE_COUNT; ++t) {
+        initial += result.initial[t];
+        survivors += result.survivors[t];
+    }
+    EXPECT_LT(survivors, initial);
+    // Only kills that were applied are reported.
+    EXPECT_EQ(observer->events.size(), static_cast<size_t>(initial - survivors));
+}
+
+TEST(BatchTest, BattleSliceCostIsFlatInPopulation) {
+    // Median time of a budgeted slice, over the first steps of a world of n
+    // NPCs. Neither sorting a new pass nor publishing a slice's kills may
+    // cost O(n), which at 16000 NPCs is some 300 us a slice; the slack
+    // covers the larger world's cache misses on a loaded machine.
+    auto sliceTime = [](int n) {
+        const std::string filename = "test_slices_" + std::to_string(n) + ".txt";
+        {
+            Editor ed;
+            std::mt19937 gen(n);
+            std::uniform_real_distribution<> pos(0.0, 100.0);
+            for (int i = 0; i < n; ++i) {
+                NPCType type = i % 2 ? NPCType::Bear : NPCType::Bittern;
+                ed.addNPC(NPCFactory::create(type, "S" + std::to_string(i), pos(gen), pos(gen)));
+            }
+            ed.saveToFile(filename);
+        }
+        GameConfig config;
+        config.event_log.clear();
+        config.verbose = false;
+        config.battle_budget = 256;
+        Game game(config);
+        game.resume(filename);
+        std::filesystem::remove(filename);
+        
+        game.start(true);
+        std::vector<std::chrono::nanoseconds> times;
+        for (int i = 0; i < 200; ++i) {
+            game.step();
+            times.push_back(game.battleSlices().last);
+        }
+        game.stop();
+        EXPECT_EQ(game.battleSlices().slices, 200u);
+        std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+        return times[times.size() / 2];
+    };
+    
+    auto small = sliceTime(500);
+    auto large = sliceTime(16000);
+    EXPECT_LT(large, 4 * small + std::chrono::microseconds(100))
+        << "500 NPCs: " << small.count() << " ns, 16000 NPCs: " << large.count() << " ns";
+}
+
+TEST(PlacementTest, PinnedSchedulerBuildsWorldOnItsCpu) {
+    auto cpus = allowedCpus();
+    ASSERT_FALSE(cpus.empty());
+    EXPECT_THROW(Scheduler(1, {CPU_SETSIZE + 1}), std::invalid_argument);
+    
+    GameConfig config;
+    config.event_log.clear();
+    config.verbose = false;
+    config.cpus = {cpus.back()};
+    Game game(config);
+    
+    int ran_on = -1;
+    // A pool pinned like the game's own one.
+    Scheduler pool(2, {cpus.back()});
+    pool.runOnWorker([&] { ran_on = currentCpu(); });
+    EXPECT_EQ(ran_on, cpus.back());
+    EXPECT_THROW(pool.runOnWorker([] { throw std::runtime_error("boom"); }), std::runtime_error);
+    for (const auto& w : pool.workerStats()) {
+        EXPECT_EQ(w.cpu, cpus.back());
+        EXPECT_EQ(w.node, numaNodeOfCpu(cpus.back()));
+    }
+    
+    game.start(true);
+    auto nodes = game.nodeStats();
+    unsigned workers = 0;
+    size_t npcs = 0;
+    for (const auto& n : nodes) {
+        workers += n.workers;
+        npcs += n.npcs;
+        if (n.workers > 0) {
+            EXPECT_EQ(n.node, numaNodeOfCpu(cpus.back()));
+            EXPECT_GT(n.resumed, 0u);
+        }
+    }
+    EXPECT_EQ(workers, 2u);
+    EXPECT_EQ(npcs, 50u);
+    game.stop();
+}
+
+TEST(TraceTest, GameWritesChromeTrace) {
+    const std::string path = "test_trace.json";
+    GameConfig config;
+    config.event_log.clear();
+    config.verbose = false;
+    config.trace = path;
+    {
+        Game game(config);
+        game.start(true);
+        EXPECT_TRUE(traceEnabled());
+        game.step(20);
+        game.stop();
+    }
+    EXPECT_FALSE(traceEnabled());
+    
+    std::ifstream in(path);
+    std::string json((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0), 0u);
+    EXPECT_NE(json.find("\"name\":\"move\""), std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"battle\""), std::string::npos);
+    EXPECT_NE(json.find("\"ph\":\"X\""), std::string::npos);
+    EXPECT_EQ(json.substr(json.size() - 3), "]}\n");
+    std::filesystem::remove(path);
+    
+    // Off: markers record nothing.
+    traceClear();
+    {
+        TRACE_SCOPE("idle");
+    }
+    EXPECT_EQ(traceEventCount(), 0u);
+}
+
+static int connectQuery(const std::string &path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    timeval timeout{2, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void sendLine(int fd, const std::string &line) {
+    std::string msg = line + "\n";
+    ASSERT_EQ(::write(fd, msg.data(), msg.size()), static_cast<ssize_t>(msg.size()));
+}
+
+// Reads one line; empty on timeout or hang-up.
+static std::string readLine(int fd) {
+    std::string line;
+    char c;
+    while (::read(fd, &c, 1) == 1) {
+        if (c == '\n') return line;
+        line += c;
+    }
+    return {};
+}
+
+// Reads a "<KIND> <version> <n>" header and its n rows.
+static std::vector<std::string> readFrame(int fd, std::uint64_t &version) {
+    std::istringstream header(readLine(fd));
+    std::string kind;
+    size_t n = 0;
+    header >> kind >> version >> n;
+    std::vector<std::string> rows;
+    for (size_t i = 0; i < n; ++i) rows.push_back(readLine(fd));
+    return rows;
+}
+
+TEST(TraceTest, RingsAreRecycledAndExportIsSafeWhileRecording) {
+    traceClear();
+    traceEnable(true);
+    
+    // Short-lived threads hand their rings on instead of leaking one each.
+    for (int i = 0; i < 64; ++i) {
+        std::thread([] { TRACE_SCOPE("short"); }).join();
+    }
+    EXPECT_LE(traceBufferCount(), 24u);
+    EXPECT_GT(traceEventCount(), 0u);
+    
+    // Exporting while a thread wraps its ring around yields whole events.
+    const std::string path = "test_trace_live.json";
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        while (!done) {
+            TRACE_SCOPE("spin");
+        }
+    });
+    for (int i = 0; i < 5; ++i) {
+        writeChromeTrace(path);
+        std::ifstream in(path);
+        std::string json((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        EXPECT_EQ(json.substr(json.size() - 3), "]}\n");
+        for (size_t at = json.find("\"ph\":\"X\""); at != std::string::npos; at = json.find("\"ph\":\"X\"", at + 1)) {
+            std::string rest = json.substr(at, 60);
+            ASSERT_TRUE(rest.find("\"name\":\"spin\"") != std::string::npos ||
+                        rest.find("\"name\":\"short\"") != std::string::npos) << rest;
+        }
+    }
+    done = true;
+    writer.join();
+    traceEnable(false);
+    traceClear();
+    EXPECT_EQ(traceEventCount(), 0u);
+    std::filesystem::remove(path);
+}
+
+TEST(QueryServerTest, ServesManyClientsAndSubscribers) {
+    const std::string path = "/tmp/lab7_query_" + std::to_string(::getpid()) + ".sock";
+    GameConfig config;
+    config.event_log.clear();
+    config.verbose = false;
+    Game game(config);
+    game.enableQueryServer(path);
+    game.start(true);
+    
+    std::vector<int> clients;
+    for (int i = 0; i < 200; ++i) {
+        int fd = connectQuery(path);
+        ASSERT_GE(fd, 0);
+        clients.push_back(fd);
+    }
+    for (int fd : clients) sendLine(fd, "STATS");
+    for (int fd : clients) {
+        std::istringstream in(readLine(fd));
+        std::string tag;
+        std::uint64_t version;
+        int alive, a, b, c;
+        in >> tag >> version >> alive >> a >> b >> c;
+        EXPECT_EQ(tag, "STATS");
+        EXPECT_EQ(alive, game.getAliveCount());
+        EXPECT_EQ(a + b + c, alive);
+    }
+    
+    int fd = clients[0];
+    sendLine(fd, "SNAPSHOT");
+    std::uint64_t version = 0;
+    auto rows = readFrame(fd, version);
+    EXPECT_EQ(version, game.snapshot()->version);
+    EXPECT_EQ(rows.size(), game.snapshot()->npcs.size());
+    
+    sendLine(fd, "REGION 0 0 50 50");
+    size_t inside = 0;
+    for (auto& npc : game.snapshot()->npcs)
+        inside += npc->x() <= 50 && npc->y() <= 50;
+    EXPECT_EQ(readFrame(fd, version).size(), inside);
+    
+    sendLine(fd, "BOGUS");
+    EXPECT_EQ(readLine(fd).rfind("ERR", 0), 0u);
+    
+    int sub = clients[1];
+    sendLine(sub, "SUBSCRIBE");
+    std::uint64_t key_version = 0;
+    auto key = readFrame(sub, key_version);
+    EXPECT_EQ(key.size(), game.snapshot()->npcs.size());
+    game.step(3);
+    std::uint64_t latest = key_version;
+    while (latest < game.snapshot()->version) {
+        std::istringstream header(readLine(sub));
+        std::string tag;
+        std::uint64_t from = 0, to = 0;
+        header >> tag >> from >> to;
+        ASSERT_EQ(tag, "DELTA");
+        ASSERT_EQ(from, latest);
+        ASSERT_GT(to, latest);
+        size_t moved, removed, spawned;
+        header >> moved >> removed >> spawned;
+        for (size_t i = 0; i < moved + removed + spawned; ++i) readLine(sub);
+        latest = to;
+    }
+    EXPECT_EQ(latest, game.snapshot()->version);
+    
+    sendLine(fd, "QUIT");
+    EXPECT_EQ(readLine(fd), "");
+    for (int c : clients) ::close(c);
+    game.stop();
+}
+
+TEST(QueryServerTest, DeltasRebuildTheWorld) {
+    const std::string path = "/tmp/lab7_delta_" + std::to_string(::getpid()) + ".sock";
+    GameConfig config;
+    config.event_log.clear();
+    config.verbose = false;
+    Game game(config);
+    QueryServerOptions opts;
+    opts.keyframe_interval = 1000;
+    game.enableQueryServer(path, opts);
+    game.start(true);
+    
+    int fd = connectQuery(path);
+    ASSERT_GE(fd, 0);
+    sendLine(fd, "SUBSCRIBE");
+    
+    // id -> position in hundredths, rebuilt from the frames alone.
+    std::map<NPCId, std::pair<long long, long long>> world;
+    std::uint64_t version = 0;
+    for (auto& row : readFrame(fd, version)) {
+        std::istringstream in(row);
+        NPCId id;
+        std::string type, name;
+        double x, y;
+        in >> id >> type >> name >> x >> y;
+        world[id] = {std::llround(x * 100), std::llround(y * 100)};
+    }
+    
+    for (int round = 0; round < 20; ++round) {
+        game.step(5);
+        while (version < game.snapshot()->version) {
+            std::istringstream header(readLine(fd));
+            std::string tag;
+            std::uint64_t from, to;
+            size_t moved, removed, spawned;
+            header >> tag >> from >> to >> moved >> removed >> spawned;
+            ASSERT_EQ(tag, "DELTA");
+            ASSERT_EQ(from, version);
+            for (size_t i = 0; i < moved; ++i) {
+                std::istringstream in(readLine(fd));
+                NPCId id;
+                long long x, y;
+                in >> id >> x >> y;
+                ASSERT_TRUE(world.count(id));
+                world[id] = {x, y};
+            }
+            for (size_t i = 0; i < removed; ++i) world.erase(static_cast<NPCId>(std::stoul(readLine(fd))));
+            EXPECT_EQ(spawned, 0u);
+            version = to;
+        }
+    }
+    
+    auto snap = game.snapshot();
+    ASSERT_EQ(world.size(), snap->npcs.size());
+    for (size_t i = 0; i < snap->npcs.size(); ++i) {
+        auto it = world.find(snap->ids[i]);
+        ASSERT_NE(it, world.end());
+        EXPECT_EQ(it->second.first, std::llround(snap->npcs[i]->x() * 100));
+        EXPECT_EQ(it->second.second, std::llround(snap->npcs[i]->y() * 100));
+    }
+    ::close(fd);
+    game.stop();
+}
+
+TEST(QueryServerTest, ChangeLogMergesRanges) {
+    ChangeLog log(4);
+    log.reset();
+    log.commit(1);
+    for (std::uint64_t v = 2; v <= 6; ++v) {
+        log.moved(static_cast<NPCId>(v % 3));
+        if (v == 5) log.removed(7);
+        log.commit(v);
+    }
+    
+    ChangeLog::Changes c;
+    EXPECT_TRUE(log.collect(3, 6, c));
+    EXPECT_EQ(c.moved, (std::vector<NPCId>{0, 1, 2}));
+    EXPECT_EQ(c.removed, (std::vector<NPCId>{7}));
+    EXPECT_TRUE(log.collect(6, 6, c));
+    EXPECT_TRUE(c.moved.empty());
+    // Version 2 was evicted.
+    EXPECT_FALSE(log.collect(1, 6, c));
+}
+
+TEST(DiscreteEventTest, FightsOnlyNeighboursAndIsRepeatable) {
+    auto build = [](Editor &ed) {
+        std::mt19937 gen(3);
+        std::uniform_real_distribution<> pos(0.0, 500.0);
+        for (int i = 0; i < 400; ++i)
+            ed.addNPC(NPCFactory::create(static_cast<NPCType>(i % 3), "N" + std::to_string(i), pos(gen), pos(gen)));
+    };
+    DiscreteEventOptions opts;
+    opts.width = opts.height = 500.0;
+    
+    Editor a, b;
+    build(a);
+    build(b);
+    auto obs = std::make_shared<TestObserver>();
+    a.addObserver(obs);
+    
+    DiscreteEventSim sa(a, 11, opts), sb(b, 11, opts);
+    EXPECT_EQ(sa.pending(), 400u);
+    sa.runUntil(std::chrono::seconds(60));
+    sb.runUntil(std::chrono::seconds(60));
+    
+    EXPECT_GT(sa.stats().actions, 400u);
+    EXPECT_EQ(sa.stats().actions, sb.stats().actions);
+    EXPECT_EQ(a.stats().counts(), b.stats().counts());
+    EXPECT_EQ(a.stats().total(), static_cast<int>(400 - sa.stats().kills));
+    EXPECT_EQ(obs->events.size(), sa.stats().kills);
+    EXPECT_LT(sa.now(), std::chrono::seconds(60));
+    // Sparse world: each action looks at a handful of neighbours, not at
+    // the whole population.
+    EXPECT_LT(sa.stats().checks, sa.stats().actions * 10);
+    
+    for (auto& npc : a.npcs()) {
+        if (!npc) continue;
+        EXPECT_GE(npc->x(), 0.0);
+        EXPECT_LE(npc->x(), 500.0);
+    }
+}
+
+TEST(DiscreteEventTest, BatchRunsInEventMode) {
+    BatchOptions opts;
+    opts.runs = 8;
+    opts.duration = std::chrono::seconds(30);
+    opts.discrete_events = true;
+    opts.threads = 1;
+    auto serial = runBatch(opts);
+    opts.threads = 2;
+    auto parallel = runBatch(opts);
+    
+    int killed = 0;
+    for (size_t i = 0; i < serial.size(); ++i) {
+        EXPECT_EQ(serial[i].survivors, parallel[i].survivors);
+        EXPECT_EQ(serial[i].sim_time, parallel[i].sim_time);
+        for (size_t t = 0; t < NPC_TYPE_COUNT; ++t) killed += serial[i].initial[t] - serial[i].survivors[t];
+    }
+    EXPECT_GT(killed, 0);
+}
+
 TEST(IntegrationTest, FullEditorWorkflow) {
     const std::string filename = "test_integration.txt";
     
@@ -649,6 +1940,251 @@ TEST(SpecialCasesTest, BearDominance) {
     EXPECT_LE(ed.npcs().size(), 2); 
 }
 
+TEST(ShardTest, LayoutOwnershipAndRegions) {
+    ShardLayout layout(2, 2, 100.0, 100.0);
+    
+    EXPECT_EQ(layout.count(), 4);
+    EXPECT_EQ(layout.ownerOf(10.0, 10.0), 0);
+    EXPECT_EQ(layout.ownerOf(60.0, 10.0), 1);
+    EXPECT_EQ(layout.ownerOf(10.0, 60.0), 2);
+    EXPECT_EQ(layout.ownerOf(100.0, 100.0), 3);
+    
+    ShardRegion r = layout.region(3);
+    EXPECT_DOUBLE_EQ(r.x0, 50.0);
+    EXPECT_DOUBLE_EQ(r.y1, 100.0);
+    EXPECT_DOUBLE_EQ(r.distanceTo(40.0, 60.0), 10.0);
+    EXPECT_EQ(layout.neighbours(0), (std::vector<int>{1, 2, 3}));
+    EXPECT_EQ(ShardLayout(3, 3, 90.0, 90.0).neighbours(4), (std::vector<int>{0, 1, 2, 3, 5, 6, 7, 8}));
+    EXPECT_THROW(ShardLayout(0, 1, 100.0, 100.0), std::invalid_argument);
+}
+
+TEST(ShardTest, MatchesSingleProcessRun) {
+    std::vector<NPCPtr> npcs;
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<> pos(0.0, 500.0);
+    for (int i = 0; i < 600; ++i) {
+        double x = pos(gen);
+        double y = pos(gen);
+        npcs.push_back(NPCFactory::create(static_cast<NPCType>(i % 3), "NPC" + std::to_string(i), x, y));
+    }
+    
+    ShardOptions opts;
+    opts.seed = 42;
+    opts.ticks = 40;
+    ShardedWorld world(ShardLayout(3, 2, 500.0, 500.0), opts);
+    auto sharded = world.run(npcs);
+    auto single = world.runInProcess(npcs);
+    
+    EXPECT_GT(sharded.migrations, 0u);
+    EXPECT_FALSE(single.kills.empty());
+    EXPECT_LT(single.survivors.size(), npcs.size());
+    EXPECT_EQ(sharded.kills, single.kills);
+    ASSERT_EQ(sharded.survivors.size(), single.survivors.size());
+    for (size_t i = 0; i < single.survivors.size(); ++i) {
+        EXPECT_EQ(sharded.survivors[i]->name(), single.survivors[i]->name());
+        EXPECT_EQ(sharded.survivors[i]->x(), single.survivors[i]->x());
+        EXPECT_EQ(sharded.survivors[i]->y(), single.survivors[i]->y());
+    }
+    
+    // Another seed is another game.
+    opts.seed = 43;
+    EXPECT_NE(ShardedWorld(ShardLayout(3, 2, 500.0, 500.0), opts).runInProcess(npcs).kills, single.kills);
+    // Regions no wider than the kill distance would need ghosts from beyond
+    // the neighbours.
+    EXPECT_THROW(ShardedWorld(ShardLayout(25, 1, 500.0, 500.0), opts), std::invalid_argument);
+}
+
+TEST(ShardTest, MatchesLockstepGame) {
+    GameConfig config;
+    config.event_log.clear();
+    config.verbose = false;
+    config.lockstep = true;
+    Game game(config);
+    
+    // A zero-length run leaves the world the seed generates.
+    const std::uint64_t seed = 9;
+    game.runHeadless(seed, std::chrono::milliseconds(0));
+    std::vector<NPCPtr> initial;
+    for (auto &n : game.getEditor().npcs()) initial.push_back(n);
+    ASSERT_EQ(initial.size(), 50u);
+    
+    auto observer = std::make_shared<BatchObserver>();
+    game.addObserver(observer);
+    auto played = game.runHeadless(seed, std::chrono::seconds(3));
+    ASSERT_FALSE(observer->events.empty());
+    // Shards do not stop at a terminal world, so positions only agree if
+    // the game played every tick.
+    ASSERT_FALSE(played.ended_early);
+    
+    ShardOptions opts;
+    opts.seed = seed;
+    opts.ticks = 30;
+    auto sharded = ShardedWorld(ShardLayout(2, 2, 100.0, 100.0), opts).run(initial);
+    EXPECT_GT(sharded.migrations, 0u);
+    
+    // Same kills, in the same rounds and order.
+    std::vector<std::pair<std::string, std::string>> kills;
+    std::vector<size_t> rounds;
+    for (size_t i = 0; i < sharded.kills.size(); ++i) {
+        const auto &k = sharded.kills[i];
+        kills.emplace_back(k.killer, k.victim);
+        if (i == 0 || k.tick != sharded.kills[i - 1].tick) rounds.push_back(0);
+        ++rounds.back();
+    }
+    EXPECT_EQ(kills, observer->events);
+    EXPECT_EQ(rounds, observer->batches);
+    
+    // Same survivors, standing in the same places.
+    std::map<std::string, std::pair<double, double>> expected;
+    for (auto &n : game.getEditor().npcs())
+        if (n) expected[n->name()] = {n->x(), n->y()};
+    ASSERT_EQ(sharded.survivors.size(), expected.size());
+    for (auto &n : sharded.survivors) {
+        ASSERT_TRUE(expected.count(n->name())) << n->name();
+        EXPECT_EQ(expected[n->name()], std::make_pair(n->x(), n->y()));
+    }
+    
+    GameConfig both = config;
+    both.discrete_events = true;
+    EXPECT_THROW(Game{both}, std::invalid_argument);
+}
+
+TEST(VariantWorldTest, StaticRulesMatchFightRules) {
+    FightRules rules;
+    std::vector<NPCPtr> npcs = {
+        NPCFactory::create(NPCType::Bear, "B", 0, 0),
+        NPCFactory::create(NPCType::Bittern, "I", 0, 0),
+        NPCFactory::create(NPCType::Desman, "D", 0, 0)
+    };
+    VariantWorld vw(npcs);
+    
+    for (size_t a = 0; a < npcs.size(); ++a) {
+        for (size_t d = 0; d < npcs.size(); ++d) {
+            EXPECT_EQ(std::visit(StaticFightRules{}, vw[a], vw[d]), npcs[a]->accept(rules, *npcs[d]));
+        }
+    }
+    EXPECT_EQ(vw.at(2).type(), "Desman");
+    EXPECT_EQ(vw.toNPCs()[1]->name(), "I");
+}
+
+TEST(VariantWorldTest, BattleMatchesEditor) {
+    Editor ed;
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<> pos(0.0, 200.0);
+    for (int i = 0; i < 200; ++i) {
+        double x = pos(gen);
+        double y = pos(gen);
+        ed.addNPC(NPCFactory::create(static_cast<NPCType>(i % 3), "NPC" + std::to_string(i), x, y));
+    }
+    
+    VariantWorld vw(ed.npcs());
+    auto observer = std::make_shared<TestObserver>();
+    auto batch = std::make_shared<BatchObserver>();
+    vw.addObserver(observer);
+    vw.addObserver(batch);
+    vw.runBattle(10.0);
+    ASSERT_EQ(batch->batches.size(), 1u);
+    EXPECT_EQ(batch->events, observer->events);
+    
+    auto expected = std::make_shared<TestObserver>();
+    ed.addObserver(expected);
+    ed.runBattle(10.0);
+    
+    ASSERT_EQ(vw.size(), ed.npcs().size());
+    for (size_t i = 0; i < vw.size(); ++i)
+        EXPECT_EQ(vw.at(i).name(), ed.npcs()[i]->name());
+    EXPECT_EQ(observer->events, expected->events);
+}
+
+TEST(CompactWorldTest, BattleSkipsTerminalAndSeparatedSpecies) {
+    auto observer = std::make_shared<TestObserver>();
+    
+    // Terminal worlds return before sorting, so insertion order survives.
+    CompactWorld16 peaceful;
+    peaceful.addObserver(observer);
+    peaceful.add(NPCType::Desman, "D1", 50.0, 0.0);
+    peaceful.add(NPCType::Bittern, "I1", 50.0, 0.0);
+    peaceful.runBattle(100.0);
+    EXPECT_TRUE(observer->events.empty());
+    ASSERT_EQ(peaceful.size(), 2u);
+    EXPECT_EQ(peaceful.name(0), "D1");
+    
+    CompactWorld32 apart;
+    apart.addObserver(observer);
+    apart.add(NPCType::Bear, "B1", 0.0, 0.0);
+    apart.add(NPCType::Bear, "B2", 10.0, 0.0);
+    apart.add(NPCType::Desman, "D1", 400.0, 400.0);
+    apart.runBattle(50.0);
+    EXPECT_TRUE(observer->events.empty());
+    EXPECT_EQ(apart.size(), 3u);
+    
+    // Same round as the Editor test, reported in x-sorted pair order.
+    CompactWorld16 chain;
+    chain.addObserver(observer);
+    chain.add(NPCType::Bear, "B1", 10.0, 0.0);
+    chain.add(NPCType::Bittern, "I1", 15.0, 0.0);
+    chain.add(NPCType::Desman, "D1", 5.0, 0.0);
+    chain.add(NPCType::Bittern, "I2", 200.0, 0.0);
+    chain.runBattle(6.0);
+    ASSERT_EQ(chain.size(), 1u);
+    EXPECT_EQ(chain.name(0), "I2");
+    std::vector<std::pair<std::string, std::string>> expected = {
+        {"D1", "B1"}, {"B1", "D1"}, {"B1", "I1"}};
+    EXPECT_EQ(observer->events, expected);
+}
+
+TEST(CompactWorldTest, BattleMatchesDoublePathOutsideTolerance) {
+    const double distance = 10.0;
+    CompactWorld16 probe;
+    const double band = 2 * probe.tolerance();
+    
+    // Keep every pairwise distance clear of the quantization band around
+    // the battle distance, where the two paths may legitimately disagree.
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<> pos(0.0, 150.0);
+    std::vector<NPCPtr> world;
+    while (world.size() < 300) {
+        double x = pos(gen), y = pos(gen);
+        bool clear = std::all_of(world.begin(), world.end(), [&](const NPCPtr &n) {
+            double d = std::hypot(n->x() - x, n->y() - y);
+            return std::abs(d - distance) > band;
+        });
+        if (clear)
+            world.push_back(NPCFactory::create(static_cast<NPCType>(world.size() % 3), "C" + std::to_string(world.size()), x, y));
+    }
+    
+    Editor ed;
+    for (auto &n : world) ed.addNPC(n);
+    auto editor_kills = std::make_shared<TestObserver>();
+    ed.addObserver(editor_kills);
+    ed.runBattle(distance);
+    std::set<std::string> expected;
+    for (auto &n : ed.npcs()) expected.insert(n->name());
+    
+    CompactWorld16 narrow(world);
+    CompactWorld32 wide(world);
+    auto observer = std::make_shared<TestObserver>();
+    narrow.addObserver(observer);
+    narrow.runBattle(distance);
+    wide.runBattle(distance);
+    
+    auto survivors = [](const auto &compact) {
+        std::set<std::string> names;
+        for (size_t i = 0; i < compact.size(); ++i) names.insert(std::string(compact.name(i)));
+        return names;
+    };
+    EXPECT_EQ(survivors(narrow), expected);
+    EXPECT_EQ(survivors(wide), expected);
+    EXPECT_EQ(observer->events.size(), editor_kills->events.size());
+    
+    EXPECT_EQ(CompactWorld16::bytesPerNPC(), 9u);
+    EXPECT_LE(narrow.step(), 0.01);
+    auto round = narrow.toNPCs();
+    ASSERT_EQ(round.size(), narrow.size());
+    EXPECT_NEAR(round[0]->x(), narrow.x(0), 1e-12);
+    EXPECT_FALSE(narrow.add(NPCType::Bear, "Outside", 501.0, 1.0));
+}
+
 int main(int argc, char **argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
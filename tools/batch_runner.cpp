@@ -0,0 +1,43 @@
+#include "BatchRunner.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Usage: Lab7_batch_runner [runs] [threads] [seed] [summary.txt] [ticks|events]
+// Plays `runs` headless games with seeds seed, seed+1, ... and writes the
+// per-species survival distributions to the summary file. "events" runs
+// the discrete-event engine instead of the tick replay.
+
+int main(int argc, char **argv) {
+    BatchOptions opts;
+    std::string output = "batch_summary.txt";
+    try {
+        if (argc > 1) opts.runs = std::stoul(argv[1]);
+        if (argc > 2) opts.threads = static_cast<unsigned>(std::stoul(argv[2]));
+        if (argc > 3) opts.base_seed = std::stoull(argv[3]);
+        if (argc > 4) output = argv[4];
+        if (argc > 5) {
+            std::string mode = argv[5];
+            if (mode != "ticks" && mode != "events") throw std::invalid_argument(mode);
+            opts.discrete_events = mode == "events";
+        }
+    } catch (const std::exception &) {
+        std::cerr << "Usage: " << argv[0] << " [runs] [threads] [seed] [summary.txt] [ticks|events]" << std::endl;
+        return 1;
+    }
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        auto results = runBatch(opts);
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        writeBatchSummary(summarizeBatch(results), output);
+        std::cout << "Played " << results.size() << " games in " << elapsed << " s" << std::endl;
+        std::cout << std::ifstream(output).rdbuf();
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include "EventLog.h"
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Usage: Lab7_log_decoder [--plain | --verbose] segment.bin...
+// Prints binary kill logs in the game_log.txt text format ("[BATTLE] A
+// killed B"), the log.txt format with --plain, or with tick, types and
+// position with --verbose.
+
+int main(int argc, char **argv) {
+    bool plain = false, verbose = false;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--plain") plain = true;
+        else if (arg == "--verbose") verbose = true;
+        else files.push_back(arg);
+    }
+    if (files.empty()) {
+        std::cerr << "Usage: " << argv[0] << " [--plain | --verbose] segment.bin..." << std::endl;
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+    try {
+        for (const auto& file : files) {
+            EventLogReader reader(file);
+            KillRecord r;
+            while (reader.next(r)) {
+                if (verbose) {
+                    std::cout << "[" << r.tick << "] " << reader.name(r.killer) << " (" << npcTypeName(r.killer_kind)
+                              << ") killed " << reader.name(r.victim) << " (" << npcTypeName(r.victim_kind) << ") at ("
+                              << std::fixed << std::setprecision(2) << r.x << ", " << r.y << ")\n";
+                } else {
+                    std::cout << (plain ? "" : "[BATTLE] ") << reader.name(r.killer)
+                              << " killed " << reader.name(r.victim) << "\n";
+                }
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Usage: Lab7_query socket COMMAND [args...]
+// Sends one request to a Game query server (see QueryServer.h) and prints
+// the reply. SUBSCRIBE keeps printing frames until interrupted.
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " socket STATS|SNAPSHOT|REGION x0 y0 x1 y1|SUBSCRIBE" << std::endl;
+        return 1;
+    }
+
+    std::string request;
+    for (int i = 2; i < argc; ++i) {
+        if (i > 2) request += ' ';
+        request += argv[i];
+    }
+    request += '\n';
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::string path = argv[1];
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: socket path too long" << std::endl;
+        return 1;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "Error: cannot connect to " << path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    if (::write(fd, request.data(), request.size()) != static_cast<ssize_t>(request.size())) {
+        std::cerr << "Error: cannot send request" << std::endl;
+        return 1;
+    }
+    // Everything but a subscription is answered and then closed.
+    if (std::string(argv[2]) != "SUBSCRIBE") ::shutdown(fd, SHUT_WR);
+
+    char buf[65536];
+    ssize_t n;
+    while ((n = ::read(fd, buf, sizeof(buf))) > 0) std::cout.write(buf, n).flush();
+    ::close(fd);
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "ShardedWorld.h"
+#include "NPCFactory.h"
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+// Usage: Lab7_shard_launcher [cols] [rows] [npcs] [seed] [ticks] [--verify]
+// Starts cols x rows shard processes on a seeded random 500x500 world and
+// steps it for `ticks` lockstep ticks (see LockstepRules). --verify runs the
+// same world in this process and checks that survivors and kills match.
+int main(int argc, char **argv) {
+    int cols = argc > 1 ? std::atoi(argv[1]) : 2;
+    int rows = argc > 2 ? std::atoi(argv[2]) : 2;
+    int count = argc > 3 ? std::atoi(argv[3]) : 2000;
+    unsigned seed = argc > 4 ? static_cast<unsigned>(std::atoi(argv[4])) : 1;
+    int ticks = argc > 5 ? std::atoi(argv[5]) : 100;
+    bool verify = argc > 6 && std::string(argv[6]) == "--verify";
+
+    const double size = 500.0;
+    std::mt19937 gen(seed);
+    std::uniform_real_distribution<> pos(0.0, size);
+    std::uniform_int_distribution<> type(0, 2);
+
+    std::vector<NPCPtr> npcs;
+    for (int i = 0; i < count; ++i) {
+        NPCType t = static_cast<NPCType>(type(gen));
+        double x = pos(gen);
+        double y = pos(gen);
+        npcs.push_back(NPCFactory::create(t, "NPC" + std::to_string(i), x, y));
+    }
+
+    try {
+        ShardOptions opts;
+        opts.seed = seed;
+        opts.ticks = ticks;
+        ShardedWorld world(ShardLayout(cols, rows, size, size), opts);
+        auto result = world.run(npcs);
+
+        std::cout << "[SHARDS] " << cols * rows << " shards, " << count << " NPCs, seed " << seed
+                  << ", " << ticks << " ticks" << std::endl;
+        std::cout << "[SHARDS] Kills: " << result.kills.size()
+                  << ", Survivors: " << result.survivors.size()
+                  << ", Migrations: " << result.migrations << std::endl;
+
+        if (verify) {
+            auto single = world.runInProcess(npcs);
+            bool same = single.kills == result.kills && single.survivors.size() == result.survivors.size();
+            for (size_t i = 0; same && i < single.survivors.size(); ++i) {
+                const NPC &a = *single.survivors[i];
+                const NPC &b = *result.survivors[i];
+                same = a.name() == b.name() && a.x() == b.x() && a.y() == b.y();
+            }
+            std::cout << "[SHARDS] Single-process survivors: " << single.survivors.size()
+                      << (same ? " (match)" : " (MISMATCH)") << std::endl;
+            return same ? 0 : 2;
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,35 @@
+#include "Trajectory.h"
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+// Usage: Lab7_trajectory_dump file.bin [id]
+// Prints a trajectory file as CSV (tick,id,name,type,x,y), optionally only
+// the rows of one NPC id.
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " file.bin [id]" << std::endl;
+        return 1;
+    }
+    bool filter = argc > 2;
+    NPCId only = filter ? static_cast<NPCId>(std::stoul(argv[2])) : 0;
+
+    std::ios::sync_with_stdio(false);
+    try {
+        TrajectoryReader reader(argv[1]);
+        TrajectoryTick tick;
+        std::cout << "tick,id,name,type,x,y\n" << std::fixed << std::setprecision(2);
+        while (reader.next(tick)) {
+            for (const auto& row : tick.rows) {
+                if (filter && row.id != only) continue;
+                std::cout << tick.tick << ',' << row.id << ',' << reader.name(row.id) << ','
+                          << npcTypeName(row.kind) << ',' << row.x << ',' << row.y << '\n';
+            }
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
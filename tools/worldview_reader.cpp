@@ -0,0 +1,47 @@
+#include "WorldView.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+// Usage: Lab7_worldview_reader [shm-name] [samples]
+// Prints per-type counts from a running Game's shared-memory world view.
+int main(int argc, char **argv) {
+    std::string name = argc > 1 ? argv[1] : "/lab7_world";
+    int samples = argc > 2 ? std::atoi(argv[2]) : 10;
+
+    try {
+        WorldViewReader reader(name);
+        std::uint64_t last = 0;
+
+        while (samples > 0) {
+            int counts[3] = {0, 0, 0};
+            std::uint64_t tick = 0;
+            std::uint32_t population = 0;
+            bool truncated = false;
+            bool ok = reader.visitLatest([&](const WorldViewFrame &f) {
+                tick = f.tick;
+                population = f.population;
+                truncated = f.truncated();
+                counts[0] = counts[1] = counts[2] = 0;
+                for (std::uint32_t i = 0; i < f.count; ++i) {
+                    if (f.entries()[i].type < 3) counts[f.entries()[i].type]++;
+                }
+            });
+
+            if (ok && tick != last) {
+                last = tick;
+                --samples;
+                std::cout << "[VIEW] tick " << tick << ": B=" << counts[0]
+                          << " I=" << counts[1] << " D=" << counts[2];
+                if (truncated) std::cout << " (frame cut off, " << population << " NPCs in the world)";
+                std::cout << std::endl;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    } catch (const std::exception &e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}